@@ -23,17 +23,66 @@ const char* testDescsTable[] =
     "Standard test without local memory",
     "Polynomial walking without local memory",
     "Polynomial walking with local memory",
+    "Memory: walking ones and zeros",
+    "Memory: moving inversions",
+    "Memory: modulo-16 pattern",
+    "Memory: random addresses",
+    "Standard test in double precision (fp64)",
+    "Polynomial walking in double precision (fp64)",
     nullptr
 };
 
+/* common part of stress kernels: optional per-workgroup signatures of output
+ * and optional kitersNum passed as kernel argument (used while calibrating) */
+const char* clKernelCommonSource =
+"#ifdef SIGNATURES\n"
+"#define SIGNATURES_ARG , global uint* signatures\n"
+"static inline uint signatureUpdate(uint sig, float4 v)\n"
+"{\n"
+"    const uint4 u = as_uint4(v);\n"
+"    sig = (rotate(sig, 5U) ^ u.x) * 0x9e3779b1U;\n"
+"    sig = (rotate(sig, 5U) ^ u.y) * 0x9e3779b1U;\n"
+"    sig = (rotate(sig, 5U) ^ u.z) * 0x9e3779b1U;\n"
+"    return (rotate(sig, 5U) ^ u.w) * 0x9e3779b1U;\n"
+"}\n"
+"static inline void signatureStore(uint sig, local uint* localSig,\n"
+"            global uint* signatures)\n"
+"{\n"
+"    const size_t lid = get_local_id(0);\n"
+"    localSig[lid] = sig;\n"
+"    barrier(CLK_LOCAL_MEM_FENCE);\n"
+"    for (uint s = SIGREDSTART; s > 0; s >>= 1)\n"
+"    {\n"
+"        if (lid < s && lid+s < GROUPSIZE)\n"
+"            localSig[lid] += localSig[lid+s];\n"
+"        barrier(CLK_LOCAL_MEM_FENCE);\n"
+"    }\n"
+"    if (lid == 0)\n"
+"        signatures[get_group_id(0)] = localSig[0];\n"
+"}\n"
+"#else\n"
+"#define SIGNATURES_ARG\n"
+"#endif\n"
+"#ifdef RUNTIME_KITERS\n"
+"#define KITERS_ARG , uint kitersNum\n"
+"#define KITERSNUM kitersNum\n"
+"#else\n"
+"#define KITERS_ARG\n"
+"#endif\n";
+
 const char* clKernel1Source =
 "#pragma OPENCL FP_CONTRACT OFF\n"
 "\n"
-"kernel void gpuStress(uint n, const global float4* input, global float4* output)\n"
+"kernel void gpuStress(uint n, const global float4* input, global float4* output\n"
+"            SIGNATURES_ARG KITERS_ARG)\n"
 "{\n"
 "    local float localData[GROUPSIZE];\n"
 "    size_t gid = get_global_id(0);\n"
 "    const size_t lid = get_local_id(0);\n"
+"#ifdef SIGNATURES\n"
+"    local uint localSig[GROUPSIZE];\n"
+"    uint sig = 0;\n"
+"#endif\n"
 "    \n"
 "    for (uint i = 0; i < BLOCKSNUM; i++)\n"
 "    {\n"
@@ -85,17 +134,31 @@ const char* clKernel1Source =
 "        output[gid*4+1] = inValue2;\n"
 "        output[gid*4+2] = inValue3;\n"
 "        output[gid*4+3] = inValue4;\n"
+"#ifdef SIGNATURES\n"
+"        sig = signatureUpdate(sig, inValue1);\n"
+"        sig = signatureUpdate(sig, inValue2);\n"
+"        sig = signatureUpdate(sig, inValue3);\n"
+"        sig = signatureUpdate(sig, inValue4);\n"
+"#endif\n"
 "        \n"
 "        gid += get_global_size(0);\n"
 "    }\n"
+"#ifdef SIGNATURES\n"
+"    signatureStore(sig, localSig, signatures);\n"
+"#endif\n"
 "}\n";
 
 const char* clKernel2Source =
 "#pragma OPENCL FP_CONTRACT OFF\n"
 "\n"
-"kernel void gpuStress(uint n, const global float4* input, global float4* output)\n"
+"kernel void gpuStress(uint n, const global float4* input, global float4* output\n"
+"            SIGNATURES_ARG KITERS_ARG)\n"
 "{\n"
 "    size_t gid = get_global_id(0);\n"
+"#ifdef SIGNATURES\n"
+"    local uint localSig[GROUPSIZE];\n"
+"    uint sig = 0;\n"
+"#endif\n"
 "    \n"
 "    for (uint i = 0; i < BLOCKSNUM; i++)\n"
 "    {\n"
@@ -134,8 +197,17 @@ const char* clKernel2Source =
 "        output[gid*4+1] = inValue2;\n"
 "        output[gid*4+2] = inValue3;\n"
 "        output[gid*4+3] = inValue4;\n"
+"#ifdef SIGNATURES\n"
+"        sig = signatureUpdate(sig, inValue1);\n"
+"        sig = signatureUpdate(sig, inValue2);\n"
+"        sig = signatureUpdate(sig, inValue3);\n"
+"        sig = signatureUpdate(sig, inValue4);\n"
+"#endif\n"
 "        gid += get_global_size(0);\n"
 "    }\n"
+"#ifdef SIGNATURES\n"
+"    signatureStore(sig, localSig, signatures);\n"
+"#endif\n"
 "}\n";
 
 const char* clKernelPWSource =
@@ -147,9 +219,14 @@ const char* clKernelPWSource =
 "}\n"
 "\n"
 "kernel void gpuStress(uint n, const global float4* input,\n"
-"            global float4* output, float p0, float p1, float p2, float p3, float p4)\n"
+"            global float4* output, float p0, float p1, float p2, float p3, float p4\n"
+"            SIGNATURES_ARG KITERS_ARG)\n"
 "{\n"
 "    size_t gid = get_global_id(0);\n"
+"#ifdef SIGNATURES\n"
+"    local uint localSig[GROUPSIZE];\n"
+"    uint sig = 0;\n"
+"#endif\n"
 "    \n"
 "    for (uint i = 0; i < BLOCKSNUM; i++)\n"
 "    {\n"
@@ -169,9 +246,18 @@ const char* clKernelPWSource =
 "        output[gid*4+1] = x2;\n"
 "        output[gid*4+2] = x3;\n"
 "        output[gid*4+3] = x4;\n"
+"#ifdef SIGNATURES\n"
+"        sig = signatureUpdate(sig, x1);\n"
+"        sig = signatureUpdate(sig, x2);\n"
+"        sig = signatureUpdate(sig, x3);\n"
+"        sig = signatureUpdate(sig, x4);\n"
+"#endif\n"
 "        \n"
 "        gid += get_global_size(0);\n"
 "    }\n"
+"#ifdef SIGNATURES\n"
+"    signatureStore(sig, localSig, signatures);\n"
+"#endif\n"
 "}\n";
 
 const char* clKernelPW2Source =
@@ -187,11 +273,16 @@ const char* clKernelPW2Source =
 "}\n"
 "\n"
 "kernel void gpuStress(uint n, const global float4* input,\n"
-"            global float4* output, float p0, float p1, float p2, float p3, float p4)\n"
+"            global float4* output, float p0, float p1, float p2, float p3, float p4\n"
+"            SIGNATURES_ARG KITERS_ARG)\n"
 "{\n"
 "    size_t gid = get_global_id(0);\n"
 "    size_t lid = get_local_id(0);\n"
 "    local float localData[GROUPSIZE];\n"
+"#ifdef SIGNATURES\n"
+"    local uint localSig[GROUPSIZE];\n"
+"    uint sig = 0;\n"
+"#endif\n"
 "    \n"
 "    for (uint i = 0; i < BLOCKSNUM; i++)\n"
 "    {\n"
@@ -223,8 +314,317 @@ const char* clKernelPW2Source =
 "        output[gid*4+1] = x2;\n"
 "        output[gid*4+2] = x3;\n"
 "        output[gid*4+3] = x4;\n"
+"#ifdef SIGNATURES\n"
+"        sig = signatureUpdate(sig, x1);\n"
+"        sig = signatureUpdate(sig, x2);\n"
+"        sig = signatureUpdate(sig, x3);\n"
+"        sig = signatureUpdate(sig, x4);\n"
+"#endif\n"
+"        \n"
+"        gid += get_global_size(0);\n"
+"    }\n"
+"#ifdef SIGNATURES\n"
+"    signatureStore(sig, localSig, signatures);\n"
+"#endif\n"
+"}\n";
+
+/* double precision variants of tests (require cl_khr_fp64): values are loaded as
+ * floats and converted to double, computed in double and stored as floats,
+ * hence buffers, initial values and verification are same as in single precision */
+const char* clKernelDPSource =
+"#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n"
+"#pragma OPENCL FP_CONTRACT OFF\n"
+"\n"
+"kernel void gpuStress(uint n, const global float4* input, global float4* output\n"
+"            SIGNATURES_ARG KITERS_ARG)\n"
+"{\n"
+"    local double localData[GROUPSIZE];\n"
+"    size_t gid = get_global_id(0);\n"
+"    const size_t lid = get_local_id(0);\n"
+"#ifdef SIGNATURES\n"
+"    local uint localSig[GROUPSIZE];\n"
+"    uint sig = 0;\n"
+"#endif\n"
+"    \n"
+"    for (uint i = 0; i < BLOCKSNUM; i++)\n"
+"    {\n"
+"        double factor;\n"
+"        double4 tmpValue1, tmpValue2, tmpValue3, tmpValue4;\n"
+"        double4 tmp2Value1, tmp2Value2, tmp2Value3, tmp2Value4;\n"
+"        \n"
+"        double4 inValue1 = convert_double4(input[gid*4]);\n"
+"        double4 inValue2 = convert_double4(input[gid*4+1]);\n"
+"        double4 inValue3 = convert_double4(input[gid*4+2]);\n"
+"        double4 inValue4 = convert_double4(input[gid*4+3]);\n"
+"        \n"
+"        for (uint j = 0; j < KITERSNUM; j++)\n"
+"        {\n"
+"            tmpValue1 = mad(inValue1, -inValue2, inValue3);\n"
+"            tmpValue2 = mad(inValue2, inValue3, inValue4);\n"
+"            tmpValue3 = mad(inValue3, -inValue4, inValue1);\n"
+"            tmpValue4 = mad(inValue4, inValue1, inValue2);\n"
+"            \n"
+"            localData[lid] = (tmpValue4.x+tmpValue4.y+tmpValue4.z+tmpValue4.w)*0.25;\n"
+"            barrier(CLK_LOCAL_MEM_FENCE);\n"
+"            factor = localData[(lid+7)%GROUPSIZE];\n"
+"            barrier(CLK_LOCAL_MEM_FENCE);\n"
+"            \n"
+"            tmpValue1 += factor;\n"
+"            tmp2Value1 = mad(tmpValue1, tmpValue2, tmpValue3);\n"
+"            tmp2Value2 = mad(tmpValue2, tmpValue3, tmpValue4);\n"
+"            tmp2Value3 = mad(tmpValue3, tmpValue4, tmpValue1);\n"
+"            tmp2Value4 = mad(tmpValue4, tmpValue1, tmpValue2);\n"
+"            \n"
+"            localData[lid] = (tmpValue2.x+tmpValue2.y+tmpValue2.z+tmpValue2.w)*0.25;\n"
+"            barrier(CLK_LOCAL_MEM_FENCE);\n"
+"            factor = localData[(lid+55)%GROUPSIZE];\n"
+"            barrier(CLK_LOCAL_MEM_FENCE);\n"
+"            \n"
+"            tmp2Value1 += factor;\n"
+"            tmpValue1 = mad(tmp2Value1, -tmp2Value2, tmp2Value3);\n"
+"            tmpValue2 = mad(tmp2Value2, tmp2Value3, -tmp2Value4);\n"
+"            tmpValue3 = mad(tmp2Value3, -tmp2Value4, tmp2Value1);\n"
+"            tmpValue4 = mad(tmp2Value4, tmp2Value1, -tmp2Value2);\n"
+"            \n"
+"            /* keep exponent in this same range as in single precision test */\n"
+"            inValue1 = as_double4((as_ulong4(tmpValue1) & (0xc0ffffffffffffffUL)) |\n"
+"                    0x4000000000000000UL);\n"
+"            inValue2 = as_double4((as_ulong4(tmpValue2) & (0xc0ffffffffffffffUL)) |\n"
+"                    0x4000000000000000UL);\n"
+"            inValue3 = as_double4((as_ulong4(tmpValue3) & (0xc0ffffffffffffffUL)) |\n"
+"                    0x4000000000000000UL);\n"
+"            inValue4 = as_double4((as_ulong4(tmpValue4) & (0xc0ffffffffffffffUL)) |\n"
+"                    0x4000000000000000UL);\n"
+"        }\n"
+"        \n"
+"        const float4 outValue1 = convert_float4(inValue1);\n"
+"        const float4 outValue2 = convert_float4(inValue2);\n"
+"        const float4 outValue3 = convert_float4(inValue3);\n"
+"        const float4 outValue4 = convert_float4(inValue4);\n"
+"        output[gid*4] = outValue1;\n"
+"        output[gid*4+1] = outValue2;\n"
+"        output[gid*4+2] = outValue3;\n"
+"        output[gid*4+3] = outValue4;\n"
+"#ifdef SIGNATURES\n"
+"        sig = signatureUpdate(sig, outValue1);\n"
+"        sig = signatureUpdate(sig, outValue2);\n"
+"        sig = signatureUpdate(sig, outValue3);\n"
+"        sig = signatureUpdate(sig, outValue4);\n"
+"#endif\n"
 "        \n"
 "        gid += get_global_size(0);\n"
 "    }\n"
+"#ifdef SIGNATURES\n"
+"    signatureStore(sig, localSig, signatures);\n"
+"#endif\n"
 "}\n";
 
+const char* clKernelPWDPSource =
+"#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n"
+"#pragma OPENCL FP_CONTRACT OFF\n"
+"\n"
+"static inline double4 polyeval4d(double p0, double p1, double p2, double p3,\n"
+"            double p4, double4 x)\n"
+"{\n"
+"    return mad(x, mad(x, mad(x, mad(x, p4, p3), p2), p1), p0);\n"
+"}\n"
+"\n"
+"kernel void gpuStress(uint n, const global float4* input,\n"
+"            global float4* output, float fp0, float fp1, float fp2, float fp3, float fp4\n"
+"            SIGNATURES_ARG KITERS_ARG)\n"
+"{\n"
+"    size_t gid = get_global_id(0);\n"
+"    const double p0 = fp0, p1 = fp1, p2 = fp2, p3 = fp3, p4 = fp4;\n"
+"#ifdef SIGNATURES\n"
+"    local uint localSig[GROUPSIZE];\n"
+"    uint sig = 0;\n"
+"#endif\n"
+"    \n"
+"    for (uint i = 0; i < BLOCKSNUM; i++)\n"
+"    {\n"
+"        double4 x1 = convert_double4(input[gid*4]);\n"
+"        double4 x2 = convert_double4(input[gid*4+1]);\n"
+"        double4 x3 = convert_double4(input[gid*4+2]);\n"
+"        double4 x4 = convert_double4(input[gid*4+3]);\n"
+"        for (uint j = 0; j < KITERSNUM; j++)\n"
+"        {\n"
+"            x1 = polyeval4d(p0, p1, p2, p3, p4, x1);\n"
+"            x2 = polyeval4d(p0, p1, p2, p3, p4, x2);\n"
+"            x3 = polyeval4d(p0, p1, p2, p3, p4, x3);\n"
+"            x4 = polyeval4d(p0, p1, p2, p3, p4, x4);\n"
+"        }\n"
+"        \n"
+"        const float4 outValue1 = convert_float4(x1);\n"
+"        const float4 outValue2 = convert_float4(x2);\n"
+"        const float4 outValue3 = convert_float4(x3);\n"
+"        const float4 outValue4 = convert_float4(x4);\n"
+"        output[gid*4] = outValue1;\n"
+"        output[gid*4+1] = outValue2;\n"
+"        output[gid*4+2] = outValue3;\n"
+"        output[gid*4+3] = outValue4;\n"
+"#ifdef SIGNATURES\n"
+"        sig = signatureUpdate(sig, outValue1);\n"
+"        sig = signatureUpdate(sig, outValue2);\n"
+"        sig = signatureUpdate(sig, outValue3);\n"
+"        sig = signatureUpdate(sig, outValue4);\n"
+"#endif\n"
+"        \n"
+"        gid += get_global_size(0);\n"
+"    }\n"
+"#ifdef SIGNATURES\n"
+"    signatureStore(sig, localSig, signatures);\n"
+"#endif\n"
+"}\n";
+
+/* memory tests: every kernel transforms 16 words of work-item (in every block) by
+ * bijection, hence memory errors are kept to the end of pass and are found by comparing
+ * with results to compare. kernels only load and store (at full memory bandwidth) */
+#define MEMTEST_KERNEL_BODY \
+"kernel void gpuStress(uint n, const global float4* input, global float4* output\n" \
+"            SIGNATURES_ARG KITERS_ARG)\n" \
+"{\n" \
+"    size_t gid = get_global_id(0);\n" \
+"#ifdef SIGNATURES\n" \
+"    local uint localSig[GROUPSIZE];\n" \
+"    uint sig = 0;\n" \
+"#endif\n" \
+"    MEMTEST_INIT;\n" \
+"    \n" \
+"    for (uint i = 0; i < BLOCKSNUM; i++)\n" \
+"    {\n" \
+"        const size_t item = MEMTEST_ITEM(gid);\n" \
+"        uint4 value1 = as_uint4(input[item*4]);\n" \
+"        uint4 value2 = as_uint4(input[item*4+1]);\n" \
+"        uint4 value3 = as_uint4(input[item*4+2]);\n" \
+"        uint4 value4 = as_uint4(input[item*4+3]);\n" \
+"        MEMTEST_TRANSFORM(value1, value2, value3, value4);\n" \
+"        output[item*4] = as_float4(value1);\n" \
+"        output[item*4+1] = as_float4(value2);\n" \
+"        output[item*4+2] = as_float4(value3);\n" \
+"        output[item*4+3] = as_float4(value4);\n" \
+"#ifdef SIGNATURES\n" \
+"        sig = signatureUpdate(sig, as_float4(value1));\n" \
+"        sig = signatureUpdate(sig, as_float4(value2));\n" \
+"        sig = signatureUpdate(sig, as_float4(value3));\n" \
+"        sig = signatureUpdate(sig, as_float4(value4));\n" \
+"#endif\n" \
+"        \n" \
+"        gid += get_global_size(0);\n" \
+"    }\n" \
+"#ifdef SIGNATURES\n" \
+"    signatureStore(sig, localSig, signatures);\n" \
+"#endif\n" \
+"}\n"
+
+/* walking ones and zeros: every word is rotated by one bit */
+const char* clKernelMemWalkingSource =
+"#define MEMTEST_INIT\n"
+"#define MEMTEST_ITEM(gid) (gid)\n"
+"#define MEMTEST_TRANSFORM(v1, v2, v3, v4) \\\n"
+"    v1 = rotate(v1, (uint4)(1U)); v2 = rotate(v2, (uint4)(1U)); \\\n"
+"    v3 = rotate(v3, (uint4)(1U)); v4 = rotate(v4, (uint4)(1U));\n"
+"\n"
+MEMTEST_KERNEL_BODY;
+
+/* moving inversions: every word is inverted */
+const char* clKernelMemInversionsSource =
+"#define MEMTEST_INIT\n"
+"#define MEMTEST_ITEM(gid) (gid)\n"
+"#define MEMTEST_TRANSFORM(v1, v2, v3, v4) \\\n"
+"    v1 = ~v1; v2 = ~v2; v3 = ~v3; v4 = ~v4;\n"
+"\n"
+MEMTEST_KERNEL_BODY;
+
+/* modulo-16: words of work-item are moved to next position and inverted,
+ * hence pattern word visits all 16 positions */
+const char* clKernelMemModuloSource =
+"#define MEMTEST_INIT\n"
+"#define MEMTEST_ITEM(gid) (gid)\n"
+"#define MEMTEST_TRANSFORM(v1, v2, v3, v4) \\\n"
+"    { const uint last = v4.w; \\\n"
+"      v4 = ~(uint4)(v3.w, v4.xyz); v3 = ~(uint4)(v2.w, v3.xyz); \\\n"
+"      v2 = ~(uint4)(v1.w, v2.xyz); v1 = ~(uint4)(last, v1.xyz); }\n"
+"\n"
+MEMTEST_KERNEL_BODY;
+
+/* random addresses: work-items are permuted over whole buffer (by multiplying
+ * by number coprime with number of work-items), words are scrambled by bijection.
+ * number of items (ITEMSNUM) and multiplier (ITEMMUL) are computed by host */
+const char* clKernelMemRandomSource =
+"#define MEMTEST_INIT\n"
+"#define MEMTEST_ITEM(gid) ((size_t)(((ulong)(gid)*ITEMMUL) % ITEMSNUM))\n"
+"#define MEMTEST_TRANSFORM(v1, v2, v3, v4) \\\n"
+"    v1 = v1*0x9E3779B1U + 0x7F4A7C15U; v2 = v2*0x9E3779B1U + 0x7F4A7C15U; \\\n"
+"    v3 = v3*0x9E3779B1U + 0x7F4A7C15U; v4 = v4*0x9E3779B1U + 0x7F4A7C15U;\n"
+"\n"
+MEMTEST_KERNEL_BODY;
+
+const char* clVerifyKernelSource =
+"kernel void verifyResults(ulong n, const global uint4* expected,\n"
+"            const global uint4* results, global uint* mismatches)\n"
+"{\n"
+"    /* mismatches: count (with padding to 8 bytes) and indices */\n"
+"    global ulong* indices = (global ulong*)(mismatches+2);\n"
+"    for (size_t gid = get_global_id(0); gid < n; gid += get_global_size(0))\n"
+"    {\n"
+"        const uint4 diff = expected[gid] ^ results[gid];\n"
+"        if ((diff.x|diff.y|diff.z|diff.w) == 0)\n"
+"            continue;\n"
+"        for (uint k = 0; k < 4; k++)\n"
+"        {\n"
+"            const uint d = (k==0) ? diff.x : (k==1) ? diff.y : (k==2) ? diff.z : diff.w;\n"
+"            if (d == 0)\n"
+"                continue;\n"
+"            const ulong index = (ulong)gid*4 + k;\n"
+"            const uint pos = atomic_inc(mismatches);\n"
+"            if (pos < MISMATCHESNUM)\n"
+"                indices[pos] = index;\n"
+"        }\n"
+"    }\n"
+"}\n";
+
+/* generator of initial values: Philox4x32-10 counter-based generator, every
+ * work-item produces 4 values from its counter (or 4 words of pattern for memory tests).
+ * must give this same values as host generator (generateInitialValues) */
+const char* clGenerateKernelSource =
+"#pragma OPENCL FP_CONTRACT OFF\n"
+"\n"
+"kernel void generateValues(uint n4, uint key0, uint key1, uint valuesType,\n"
+"            global uint4* output)\n"
+"{\n"
+"    const uint gid = get_global_id(0);\n"
+"    if (gid >= n4)\n"
+"        return;\n"
+"    const uint4 addr = (uint4)(gid*4, gid*4+1, gid*4+2, gid*4+3);\n"
+"    if (valuesType == 2)\n"
+"    {   /* walking ones (even words) and walking zeros (odd words) */\n"
+"        const uint4 ones = (uint4)(1U) << (addr & 31U);\n"
+"        output[gid] = (uint4)(ones.x, ~ones.y, ones.z, ~ones.w);\n"
+"        return;\n"
+"    }\n"
+"    if (valuesType == 3)\n"
+"    {   /* modulo-16: zero at first word of every 16 words, ones elsewhere */\n"
+"        output[gid] = select((uint4)(0xffffffffU), (uint4)(0U), (addr & 15U) == 0U);\n"
+"        return;\n"
+"    }\n"
+"    uint4 x = (uint4)(gid, 0, 0, 0);\n"
+"    uint k0 = key0, k1 = key1;\n"
+"    for (uint r = 0; r < 10; r++)\n"
+"    {\n"
+"        const uint hi0 = mul_hi(0xD2511F53U, x.x), lo0 = 0xD2511F53U*x.x;\n"
+"        const uint hi1 = mul_hi(0xCD9E8D57U, x.z), lo1 = 0xCD9E8D57U*x.z;\n"
+"        x = (uint4)(hi1^x.y^k0, lo1, hi0^x.w^k1, lo0);\n"
+"        k0 += 0x9E3779B9U;\n"
+"        k1 += 0xBB67AE85U;\n"
+"    }\n"
+"    if (valuesType == 4) // random bits\n"
+"    {\n"
+"        output[gid] = x;\n"
+"        return;\n"
+"    }\n"
+"    const float4 u = convert_float4(x >> 8) * (1.0f/16777216.0f);\n"
+"    if (valuesType == 0)\n"
+"        output[gid] = as_uint4((u-0.5f)*0.04f);\n"
+"    else\n"
+"        output[gid] = as_uint4(u*2e6f - 1e6f);\n"
+"}\n";
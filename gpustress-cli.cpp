@@ -52,10 +52,12 @@ static const char* workFactorsString = nullptr;
 static const char* blocksNumsString = nullptr;
 static const char* passItersNumsString = nullptr;
 static const char* kitersNumsString = nullptr;
+static const char* pipelineDepthsString = nullptr;
 static int dontWait = 0;
 static int printHelp = 0;
 static int printUsage = 0;
 static int printVersion = 0;
+static int autotuneMode = 0;
 
 static const poptOption optionsTable[] =
 {
@@ -74,7 +76,7 @@ static const poptOption optionsTable[] =
         "Use NVIDIA platform", nullptr },
     { "useIntel", 'E', POPT_ARG_VAL, &useIntelPlatform, 'L', "Use Intel platform", nullptr },
     { "testType", 'T', POPT_ARG_STRING, &builtinKernelsString, 'T',
-        "Choose test type (kernel) (range 0-3)", "NUMLIST" },
+        "Choose test type (kernel) (range 0-9)", "NUMLIST" },
     { "inAndOut", 'I', POPT_ARG_STRING|POPT_ARGFLAG_OPTIONAL, &inputAndOutputsString, 'I',
         "Use input and output buffers (doubles memory reqs.)", "BOOLLIST" },
     { "workFactor", 'W', POPT_ARG_STRING, &workFactorsString, 'W',
@@ -87,9 +89,51 @@ static const poptOption optionsTable[] =
         "Set pass iterations num", "ITERSLIST" },
     { "kitersNum", 'j', POPT_ARG_STRING, &kitersNumsString, 'j',
         "Set kernel iterations number (range 1-100)", "ITERSLIST" },
+    { "pipelineDepth", 'P', POPT_ARG_STRING, &pipelineDepthsString, 'P',
+        "Set number of buffer sets in pipeline (range 1-16)", "DEPTHLIST" },
     { "dontWait", 'w', POPT_ARG_VAL, &dontWait, 'w', "Dont wait few seconds", nullptr },
     { "exitIfAllFails", 'f', POPT_ARG_VAL, &exitIfAllFails, 'f',
         "Exit only when all devices will fail at computation", nullptr },
+    { "verifyMode", 'v', POPT_ARG_INT, &verificationMode, 'v',
+        "Set results verification mode (0 - on host, 1 - on device, 2 - signatures, "
+        "3 - streaming)",
+        "MODE" },
+    { "pinnedMemory", 'M', POPT_ARG_VAL, &usePinnedMemory, 'M',
+        "Use pinned host memory for transfers", nullptr },
+    { "stopLatency", 'y', POPT_ARG_INT, &maxStopLatency, 'y',
+        "Set maximal latency of stopping test in milliseconds (default 300)", "MILLIS" },
+    { "enqueueBench", 'Q', POPT_ARG_VAL, &enqueueBenchmark, 'Q',
+        "Measure throughput of kernels queueing before test", nullptr },
+    { "programCache", 'K', POPT_ARG_STRING, &programCacheDir, 'K',
+        "Cache binaries of compiled programs in directory", "DIRECTORY" },
+    { "calibrationDB", 'D', POPT_ARG_STRING, &calibrationDBFile, 'D',
+        "Store calibrations in file and reuse them", "FILE" },
+    { "calibrationTolerance", 'x', POPT_ARG_INT, &calibrationTolerance, 'x',
+        "Set tolerance of stored calibration validation in percents (default 10)",
+        "PERCENT" },
+    { "exhaustiveCalibration", 'X', POPT_ARG_VAL, &exhaustiveCalibration, 'X',
+        "Calibrate by checking all kitersNum values (1-40)", nullptr },
+    { "specializedCalibration", 'Z', POPT_ARG_VAL, &specializedCalibration, 'Z',
+        "Calibrate by compiling program for every checked kitersNum", nullptr },
+    { "seed", 'R', POPT_ARG_STRING, &randomSeedString, 'R',
+        "Set seed of random initial values (default random)", "SEED" },
+    { "hostInitialValues", 'H', POPT_ARG_VAL, &hostInitialValues, 'H',
+        "Generate initial values on host and upload them", nullptr },
+    { "memTarget", 'm', POPT_ARG_STRING, &memoryTargetString, 'm',
+        "Set device memory used by test in megabytes or in percents of device memory "
+        "(with '%'), workFactor and blocksNum are derived from it", "MB|PERCENT%" },
+    { "memPool", 'O', POPT_ARG_STRING, &memoryPoolString, 'O',
+        "Allocate memory pool (in megabytes or in percents of device memory) and "
+        "use its other part in every pass", "MB|PERCENT%" },
+    { "autotune", 'U', POPT_ARG_VAL, &autotuneMode, 'U',
+        "Autotune groupSize, workFactor, blocksNum, kitersNum and print options", nullptr },
+    { "autotuneTime", 0, POPT_ARG_INT, &autotuneTime, 0,
+        "Set autotuning time for device in seconds (default 60)", "SECONDS" },
+    { "autotuneMemory", 0, POPT_ARG_INT, &autotuneMemory, 0,
+        "Set memory limit for autotuning in megabytes (default no limit)", "MB" },
+    { "autotuneObjective", 0, POPT_ARG_INT, &autotuneObjective, 0,
+        "Set autotuning objective (0 - bandwidth*perf, 1 - perf, 2 - bandwidth)",
+        "OBJECTIVE" },
     { "version", 'V', POPT_ARG_VAL, &printVersion, 'V', "Print program version", nullptr },
     { "help", '?', POPT_ARG_VAL, &printHelp, '?', "Show this help message", nullptr },
     { "usage", 0, POPT_ARG_VAL, &printUsage, 'u', "Display brief usage message", nullptr },
@@ -380,10 +424,12 @@ int main(int argc, const char** argv)
                     parseCmdUIntList(builtinKernelsString, "testTypes");
             std::vector<bool> inputAndOutputs =
                     parseCmdBoolList(inputAndOutputsString, "inputAndOutputs");
+            std::vector<cxuint> pipelineDepths =
+                    parseCmdUIntList(pipelineDepthsString, "pipeline depths");
             
             gpuStressConfigs = collectGPUStressConfigs(choosenCLDevices.size(),
                     passItersNums, groupSizes, workFactors, blocksNums, kitersNums,
-                    builtinKernels, inputAndOutputs);
+                    builtinKernels, inputAndOutputs, pipelineDepths);
         }
         
         std::cout <<
@@ -416,9 +462,59 @@ int main(int argc, const char** argv)
         
         installSignals();
         
+        if (autotuneMode != 0)
+        {   /* autotune devices concurrently and print options to replay */
+            std::vector<GPUStressConfig> tunedConfigs(gpuStressConfigs);
+            std::vector<std::thread> autotuneThreads;
+            // each thread stores own result, combined after join
+            std::vector<int> autotuneRetVals(choosenCLDevices.size(), 0);
+            for (size_t i = 0; i < choosenCLDevices.size(); i++)
+                autotuneThreads.push_back(std::thread(
+                    [i,&autotuneRetVals,&choosenCLDevices,&gpuStressConfigs,&tunedConfigs]()
+                {
+                    try
+                    {
+                        if (!isGPUStressConfigSupported(choosenCLDevices[i],
+                                    gpuStressConfigs[i]))
+                        {   // skip device, other devices are autotuned
+                            printUnsupportedDevice(i, choosenCLDevices[i]);
+                            return;
+                        }
+                        tunedConfigs[i] = autotuneGPUStressConfig(i, choosenCLDevices[i],
+                                gpuStressConfigs[i]);
+                    }
+                    catch(const cl::Error& error)
+                    {
+                        std::lock_guard<std::mutex> l(stdOutputMutex);
+                        *errStream << "#" << i << " OpenCL error happened: " <<
+                                error.what() << ", Code: " << error.err() << std::endl;
+                        autotuneRetVals[i] = 1;
+                    }
+                    catch(const std::exception& ex)
+                    {
+                        std::lock_guard<std::mutex> l(stdOutputMutex);
+                        *errStream << "#" << i << " Exception happened: " <<
+                                ex.what() << std::endl;
+                        autotuneRetVals[i] = 1;
+                    }
+                }));
+            for (std::thread& thread: autotuneThreads)
+                thread.join();
+            for (int threadRetVal: autotuneRetVals)
+                if (threadRetVal != 0)
+                    retVal = 1;
+            if (retVal == 0 && !stopAllStressTestersByUser.load())
+                std::cout << "Autotuned options: " <<
+                        getGPUStressConfigsOptions(tunedConfigs) << std::endl;
+            uninstallSignals();
+            poptFreeContext(optsContext);
+            return retVal;
+        }
+        
         bool ifExitingAtInit = false;
         
-        {   /* create thread for preparing GPUStressTesters
+        {   /* create thread for preparing GPUStressTesters (devices are prepared
+             * concurrently in threads created by this thread)
              * avoids catching signals during kernel compilation,
              * because can cause internal errors */
             std::thread preparingThread(
@@ -427,19 +523,11 @@ int main(int argc, const char** argv)
             {
                 try
                 {
-                    for (size_t i = 0; i < choosenCLDevices.size(); i++)
-                    {
-                        cl::Device& clDevice = choosenCLDevices[i];
-                        GPUStressTester* stressTester = new GPUStressTester(i, clDevice,
-                                    gpuStressConfigs[i]);
-                        if (!stressTester->isInitialized())
-                        {
-                            ifExitingAtInit = true;
-                            delete stressTester;
-                            break;
-                        }
-                        gpuStressTesters.push_back(stressTester);
-                    }
+                    if (!createGPUStressTesters(choosenCLDevices, gpuStressConfigs,
+                                gpuStressTesters))
+                        retVal = 1;
+                    // null testers of skipped devices are not started
+                    ifExitingAtInit = stopAllStressTestersByUser.load();
                 }
                 catch(const cl::Error& error)
                 {
@@ -465,8 +553,9 @@ int main(int argc, const char** argv)
         }
         if (!ifExitingAtInit && retVal==0)
             for (size_t i = 0; i < choosenCLDevices.size(); i++)
-                testerThreads.push_back(new std::thread(
-                        &GPUStressTester::runTest, gpuStressTesters[i]));
+                testerThreads.push_back((gpuStressTesters[i] != nullptr) ?
+                        new std::thread(&GPUStressTester::runTest, gpuStressTesters[i]) :
+                        nullptr);
     }
     catch(const cl::Error& error)
     {
@@ -513,6 +602,8 @@ int main(int argc, const char** argv)
         
         for (size_t i = 0; i < gpuStressTesters.size(); i++)
         {
+            if (gpuStressTesters[i] == nullptr)
+                continue;
             if (gpuStressTesters[i]->isFailed())
             {
                 retVal = 1;
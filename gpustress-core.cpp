@@ -26,15 +26,30 @@
 #include <cstdio>
 #include <cmath>
 #include <cstring>
+#include <climits>
+#include <cerrno>
 #include <utility>
 #include <set>
 #include <cmath>
-#ifdef _WINDOWS
+#include <deque>
+#include <map>
+#include <functional>
 #include <thread>
+#ifdef _WINDOWS
 #include <windows.h>
 #endif
 #include "gpustress-core.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define HAVE_SSE2 1
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    (__GNUC__ >= 5 || defined(__clang__))
+#  include <immintrin.h>
+#  define HAVE_AVX2_TARGET 1
+#endif
+
 #ifdef _MSC_VER
 #  define snprintf _snprintf
 #  define SIZE_T_SPEC "%Iu"
@@ -267,7 +282,8 @@ std::vector<GPUStressConfig> collectGPUStressConfigs(cxuint devicesNum,
         const std::vector<cxuint>& passItersNumVec, const std::vector<cxuint>& groupSizeVec,
         const std::vector<cxuint>& workFactorVec,
         const std::vector<cxuint>& blocksNumVec, const std::vector<cxuint>& kitersNumVec,
-        const std::vector<cxuint>& builtinKernelVec, const std::vector<bool>& inAndOutVec)
+        const std::vector<cxuint>& builtinKernelVec, const std::vector<bool>& inAndOutVec,
+        const std::vector<cxuint>& pipelineDepthVec)
 {
     if (passItersNumVec.size() > devicesNum)
         throw MyException("PassItersNum list is too long");
@@ -283,6 +299,8 @@ std::vector<GPUStressConfig> collectGPUStressConfigs(cxuint devicesNum,
         throw MyException("TestType list is too long");
     if (inAndOutVec.size() > devicesNum)
         throw MyException("InputAndOutput list is too long");
+    if (pipelineDepthVec.size() > devicesNum)
+        throw MyException("PipelineDepth list is too long");
     
     std::vector<GPUStressConfig> outConfigs(devicesNum);
     
@@ -331,28 +349,61 @@ std::vector<GPUStressConfig> collectGPUStressConfigs(cxuint devicesNum,
         else // default
             config.inputAndOutput = false;
         
+        if (!pipelineDepthVec.empty())
+            config.pipelineDepth = (pipelineDepthVec.size() > i) ? pipelineDepthVec[i] :
+                    pipelineDepthVec.back();
+        else // default
+            config.pipelineDepth = 2;
+        
         if (config.passItersNum == 0)
             throw MyException("PassItersNum is zero");
         if (config.blocksNum == 0 || config.blocksNum > 16)
             throw MyException("BlocksNum is zero or out of range");
         if (config.workFactor == 0)
             throw MyException("WorkFactor is zero");
-        if (config.builtinKernel > 3)
+        if (config.builtinKernel > 9)
             throw MyException("BuiltinKernel out of range");
         if (config.kitersNum > 100)
             throw MyException("KitersNum out of range");
+        if (config.pipelineDepth == 0 || config.pipelineDepth > 16)
+            throw MyException("PipelineDepth is zero or out of range");
         outConfigs[i] = config;
     }
     
     return outConfigs;
 }
 
+extern const char* clKernelCommonSource;
 extern const char* clKernel1Source;
 extern const char* clKernel2Source;
 extern const char* clKernelPWSource;
 extern const char* clKernelPW2Source;
+extern const char* clKernelDPSource;
+extern const char* clKernelPWDPSource;
+extern const char* clKernelMemWalkingSource;
+extern const char* clKernelMemInversionsSource;
+extern const char* clKernelMemModuloSource;
+extern const char* clKernelMemRandomSource;
+extern const char* clVerifyKernelSource;
+extern const char* clGenerateKernelSource;
 
 int exitIfAllFails = 0;
+int verificationMode = 0;
+int maxStopLatency = 300;
+int enqueueBenchmark = 0;
+const char* programCacheDir = nullptr;
+const char* calibrationDBFile = nullptr;
+int calibrationTolerance = 10;
+int exhaustiveCalibration = 0;
+int specializedCalibration = 0;
+const char* randomSeedString = nullptr;
+int hostInitialValues = 0;
+const char* memoryTargetString = nullptr;
+const char* memoryPoolString = nullptr;
+int autotuneTime = 60;
+int autotuneMemory = 0;
+int autotuneObjective = 0;
+int usePinnedMemory = 0;
 
 std::mutex stdOutputMutex;
 std::ostream* outStream = nullptr;
@@ -361,6 +412,10 @@ std::ostream* errStream = nullptr;
 std::atomic<bool> stopAllStressTestersIfFail(false);
 std::atomic<bool> stopAllStressTestersByUser(false);
 
+/* preparing (and calibration) is stopped by user or if some device failed */
+static bool isPreparingStopped()
+{ return stopAllStressTestersByUser.load() || stopAllStressTestersIfFail.load(); }
+
 OutputHandler outputHandler = nullptr;
 void* outputHandlerData = nullptr;
 
@@ -373,264 +428,1556 @@ void installOutputHandler(std::ostream* out, std::ostream* err,
     outputHandlerData = data;
 }
 
-static const float examplePoly[5] = 
-{ 4.43859953e+05,   1.13454169e+00,  -4.50175916e-06, -1.43865531e-12,   4.42133541e-18 };
+/*
+ * small pool of worker threads (shared by all stress testers)
+ */
 
-GPUStressTester::GPUStressTester(cxuint _id, cl::Device& _clDevice,
-        const GPUStressConfig& config)
-try :
-        id(_id), workFactor(config.workFactor),
-        blocksNum(config.blocksNum), passItersNum(config.passItersNum),
-        kitersNum(config.kitersNum), useInputAndOutput(config.inputAndOutput),
-        initialValues(nullptr), toCompare(nullptr), results(nullptr)
+class WorkerPool
 {
-    initialized = false;
-    failed = false;
-    usePolyWalker = false;
-    // set clDevice, after because can fails and pointers to free must be set
-    clDevice = _clDevice;
-    
-    cl::Platform clPlatform;
-    clDevice.getInfo(CL_DEVICE_PLATFORM, &clPlatform);
-    
-    clPlatform.getInfo(CL_PLATFORM_NAME, &platformName);
-    platformName = trimSpaces(platformName);
-    clDevice.getInfo(CL_DEVICE_NAME, &deviceName);
-    deviceName = trimSpaces(deviceName);
-    
-    cl_uint maxComputeUnits;
-    if (config.groupSize == 0)
-        clDevice.getInfo(CL_DEVICE_MAX_WORK_GROUP_SIZE, &groupSize);
-    else // from config
-        groupSize = config.groupSize;
-    clDevice.getInfo(CL_DEVICE_MAX_COMPUTE_UNITS, &maxComputeUnits);
-    
-    workSize = size_t(maxComputeUnits)*groupSize*workFactor;
-    bufItemsNum = (workSize<<4)*blocksNum;
-    
-    switch(config.builtinKernel)
-    {
-        case 0:
-            clKernelSource = clKernel1Source;
-            break;
-        case 1:
-            clKernelSource = clKernel2Source;
-            break;
-        case 2:
-            clKernelSource = clKernelPWSource;
-            usePolyWalker = true;
-            break;
-        case 3:
-            clKernelSource = clKernelPW2Source;
-            usePolyWalker = true;
-            break;
-        default:
-            throw MyException("Unsupported builtin kernel!");
-            break;
-    }
-    clKernelSourceSize = ::strlen(clKernelSource);
-    
-    {
-        double devMemReqs = 0.0;
-        if (useInputAndOutput)
-            devMemReqs = (bufItemsNum<<4)/(1048576.0);
-        else
-            devMemReqs = (bufItemsNum<<3)/(1048576.0);
-        
-        std::lock_guard<std::mutex> l(stdOutputMutex);
-        *outStream << "Preparing StressTester for\n  " <<
-                "#" << id << " " << platformName << ":" << deviceName <<
-                "\n    SetUp: workSize=" << workSize <<
-                ", memory=" << devMemReqs << " MB"
-                ", workFactor=" << workFactor <<
-                ", blocksNum=" << blocksNum <<
-                ",\n    computeUnits=" << maxComputeUnits <<
-                ", groupSize=" << groupSize <<
-                ", passIters=" << passItersNum <<
-                ", testType=" << config.builtinKernel <<
-                ",\n    inputAndOutput=" << (useInputAndOutput?"yes":"no") << std::endl;
-        handleOutput(id);
-    }
-    
-    if (stopAllStressTestersByUser.load())
+private:
+    struct Job
     {
-        std::lock_guard<std::mutex> l(stdOutputMutex);
-        *outStream << "#" << id << " Exiting, because user stopped test." << std::endl;
-        handleOutput(id);
-        return;
-    }
+        const std::function<void(cxuint)>* func;
+        cxuint partsNum;
+        cxuint nextPart;
+        cxuint finishedParts;
+        std::exception_ptr exception;
+    };
     
-    cl_context_properties clContextProps[3];
-    clContextProps[0] = CL_CONTEXT_PLATFORM;
-    clContextProps[1] = reinterpret_cast<cl_context_properties>(clPlatform());
-    clContextProps[2] = 0;
-    clContext = cl::Context(clDevice, clContextProps);
-    
-    clCmdQueue1 = cl::CommandQueue(clContext, clDevice);
-    clCmdQueue2 = cl::CommandQueue(clContext, clDevice);
+    std::mutex mutex;
+    std::condition_variable workCond;
+    std::condition_variable doneCond;
+    std::deque<Job*> jobs;
+    std::vector<std::thread> threads;
     
-    clBuffer1 = cl::Buffer(clContext, CL_MEM_READ_WRITE, bufItemsNum<<2);
-    if (useInputAndOutput)
-        clBuffer2 = cl::Buffer(clContext, CL_MEM_READ_WRITE, bufItemsNum<<2);
-    clBuffer3 = cl::Buffer(clContext, CL_MEM_READ_WRITE, bufItemsNum<<2);
-    if (useInputAndOutput)
-        clBuffer4 = cl::Buffer(clContext, CL_MEM_READ_WRITE, bufItemsNum<<2);
+    bool runNextPart(std::unique_lock<std::mutex>& lock, Job& job);
+    void workerLoop();
+public:
+    explicit WorkerPool(cxuint threadsNum);
     
-    initialValues = new float[bufItemsNum];
-    toCompare = new float[bufItemsNum];
-    results = new float[bufItemsNum];
+    // threads number including caller thread
+    cxuint getThreadsNum() const
+    { return threads.size()+1; }
     
-    std::mt19937_64 random;
-    if (!usePolyWalker)
+    // call func for all parts (0..partsNum-1) and wait for finish
+    void runParts(cxuint partsNum, const std::function<void(cxuint)>& func);
+};
+
+WorkerPool::WorkerPool(cxuint threadsNum)
+{
+    for (cxuint i = 1; i < threadsNum; i++)
+        threads.push_back(std::thread(&WorkerPool::workerLoop, this));
+}
+
+/* run next part of job, parts are taken under lock, hence job is not referenced
+ * after all parts have been finished */
+bool WorkerPool::runNextPart(std::unique_lock<std::mutex>& lock, Job& job)
+{
+    if (job.nextPart >= job.partsNum)
+        return false;
+    const cxuint part = job.nextPart++;
+    if (job.nextPart >= job.partsNum)
+        jobs.erase(std::find(jobs.begin(), jobs.end(), &job));
+    lock.unlock();
+    std::exception_ptr exception;
+    try
+    { (*job.func)(part); }
+    catch(...)
+    { exception = std::current_exception(); }
+    lock.lock();
+    if (exception)
+        job.exception = exception;
+    job.finishedParts++;
+    if (job.finishedParts == job.partsNum)
+        doneCond.notify_all();
+    return true;
+}
+
+void WorkerPool::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
     {
-        for (size_t i = 0; i < bufItemsNum; i++)
-            initialValues[i] = (float(random())/float(
-                        std::mt19937_64::max()-std::mt19937_64::min())-0.5f)*0.04f;
-    }
-    else
-    {   /* data for polywalker */
-        for (size_t i = 0; i < bufItemsNum; i++)
-            initialValues[i] = (float(random())/float(
-                        std::mt19937_64::max()-std::mt19937_64::min()))*2e6 - 1e6;
+        workCond.wait(lock, [this]() { return !jobs.empty(); });
+        runNextPart(lock, *jobs.front());
     }
-    
-    calibrateKernel();
-    if (stopAllStressTestersByUser.load())
-    {
-        std::lock_guard<std::mutex> l(stdOutputMutex);
-        *outStream << "#" << id << " Exiting, because user stopped test." << std::endl;
-        handleOutput(id);
+}
+
+void WorkerPool::runParts(cxuint partsNum, const std::function<void(cxuint)>& func)
+{
+    if (partsNum == 0)
         return;
-    }
+    Job job;
+    job.func = &func;
+    job.partsNum = partsNum;
+    job.nextPart = 0;
+    job.finishedParts = 0;
     
-    clCmdQueue1.enqueueWriteBuffer(clBuffer1, CL_TRUE, size_t(0), bufItemsNum<<2,
-            initialValues);
-    
-    clKernel.setArg(0, cl_uint(workSize));
-    if (usePolyWalker)
+    std::unique_lock<std::mutex> lock(mutex);
+    jobs.push_back(&job);
+    workCond.notify_all();
+    while (runNextPart(lock, job)); // caller thread also works
+    doneCond.wait(lock, [&job]() { return job.finishedParts == job.partsNum; });
+    lock.unlock();
+    if (job.exception)
+        std::rethrow_exception(job.exception);
+}
+
+static std::mutex workerPoolMutex;
+static WorkerPool* workerPool = nullptr;
+
+/* worker pool lives until end of program */
+static WorkerPool& getWorkerPool()
+{
+    std::lock_guard<std::mutex> l(workerPoolMutex);
+    if (workerPool == nullptr)
+        workerPool = new WorkerPool(std::max(1U,
+                    std::min(8U, std::thread::hardware_concurrency())));
+    return *workerPool;
+}
+
+/*
+ * program binary cache
+ */
+
+static uint64_t fnv1a64(const void* data, size_t size,
+            uint64_t hash = 14695981039346656037ULL)
+{
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    return hash;
+}
+
+static const char programCacheMagic[8] = { 'G', 'P', 'U', 'S', 'B', 'I', 'N', '1' };
+
+/* cache file: magic, key size (32-bit), key, binary size (64-bit),
+ * binary checksum (64-bit), binary. returns false if file is missing or invalid */
+static bool loadProgramBinary(const std::string& filename, const std::string& key,
+            std::vector<unsigned char>& binary)
+{
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+    bool good = false;
+    char magic[8];
+    uint32_t keySize;
+    uint64_t binarySize, checksum;
+    if (fread(magic, 8, 1, file) == 1 && ::memcmp(magic, programCacheMagic, 8) == 0 &&
+        fread(&keySize, 4, 1, file) == 1 && keySize == key.size())
     {
-        clKernel.setArg(3, examplePoly[0]);
-        clKernel.setArg(4, examplePoly[1]);
-        clKernel.setArg(5, examplePoly[2]);
-        clKernel.setArg(6, examplePoly[3]);
-        clKernel.setArg(7, examplePoly[4]);
+        std::string fileKey(keySize, ' ');
+        if (fread(&fileKey[0], 1, keySize, file) == keySize && fileKey == key &&
+            fread(&binarySize, 8, 1, file) == 1 && fread(&checksum, 8, 1, file) == 1 &&
+            binarySize != 0 && binarySize < (uint64_t(1)<<32))
+        {
+            binary.resize(binarySize);
+            good = (fread(binary.data(), 1, binarySize, file) == binarySize &&
+                    fgetc(file) == EOF && fnv1a64(binary.data(), binarySize) == checksum);
+        }
     }
-    /* generate values to compare */
-    if (!useInputAndOutput)
+    fclose(file);
+    return good;
+}
+
+/* write to temporary file and rename it, hence other readers never see partial file */
+static bool storeProgramBinary(const std::string& filename, const std::string& key,
+            const std::vector<unsigned char>& binary)
+{
+    const std::string tmpFilename = filename + ".tmp" + std::to_string(
+            std::hash<std::thread::id>()(std::this_thread::get_id()));
+    FILE* file = fopen(tmpFilename.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+    const uint32_t keySize = key.size();
+    const uint64_t binarySize = binary.size();
+    const uint64_t checksum = fnv1a64(binary.data(), binary.size());
+    bool good = (fwrite(programCacheMagic, 8, 1, file) == 1 &&
+            fwrite(&keySize, 4, 1, file) == 1 &&
+            fwrite(key.data(), 1, keySize, file) == keySize &&
+            fwrite(&binarySize, 8, 1, file) == 1 && fwrite(&checksum, 8, 1, file) == 1 &&
+            fwrite(binary.data(), 1, binarySize, file) == binarySize);
+    good = (fclose(file) == 0) && good;
+    if (good && std::rename(tmpFilename.c_str(), filename.c_str()) != 0)
+    {   // on Windows rename fails if destination exists
+        std::remove(filename.c_str());
+        good = (std::rename(tmpFilename.c_str(), filename.c_str()) == 0);
+    }
+    if (!good)
+        std::remove(tmpFilename.c_str());
+    return good;
+}
+
+/*
+ * calibration database
+ */
+
+/* database is text file, single line for entry: key, tab and values */
+struct CalibrationEntry
+{
+    cxuint kitersNum;
+    size_t groupSize; // fixed group size
+    cxuint workFactor; // fixed work factor
+    cl_ulong kernelTime;
+    double bandwidth;
+    double perf;
+};
+
+static std::mutex calibrationDBMutex;
+
+static bool findCalibrationEntry(const std::string& key, CalibrationEntry& entry)
+{
+    std::lock_guard<std::mutex> l(calibrationDBMutex);
+    FILE* file = fopen(calibrationDBFile, "rb");
+    if (file == nullptr)
+        return false;
+    bool found = false;
+    char line[4096];
+    while (!found && fgets(line, 4096, file) != nullptr)
     {
-        clKernel.setArg(1, clBuffer1());
-        clKernel.setArg(2, clBuffer1());
+        const char* tabPos = ::strchr(line, '\t');
+        if (tabPos == nullptr || key.compare(0, std::string::npos, line, tabPos-line) != 0)
+            continue;
+        unsigned long long groupSize, kernelTime;
+        found = (sscanf(tabPos+1, "%u %llu %u %llu %lf %lf", &entry.kitersNum, &groupSize,
+                &entry.workFactor, &kernelTime, &entry.bandwidth, &entry.perf) == 6 &&
+                entry.kitersNum != 0 && groupSize != 0 && kernelTime != 0);
+        entry.groupSize = groupSize;
+        entry.kernelTime = kernelTime;
     }
-    
-    for (cxuint i = 0; i < passItersNum; i++)
+    fclose(file);
+    return found;
+}
+
+/* replace or add entry, file is rewritten by temporary file */
+static bool storeCalibrationEntry(const std::string& key, const CalibrationEntry& entry)
+{
+    std::lock_guard<std::mutex> l(calibrationDBMutex);
+    std::vector<std::string> lines;
+    FILE* file = fopen(calibrationDBFile, "rb");
+    if (file != nullptr)
     {
-        if (stopAllStressTestersByUser.load())
-            break; // skip this
-        
-        if (useInputAndOutput)
-        {
-            if ((i&1) == 0)
-            {
-                clKernel.setArg(1, clBuffer1());
-                clKernel.setArg(2, clBuffer2());
-            }
-            else
-            {
-                clKernel.setArg(1, clBuffer2());
-                clKernel.setArg(2, clBuffer1());
-            }
-        }
-        cl::Event clEvent;
-        clCmdQueue1.enqueueNDRangeKernel(clKernel, cl::NDRange(0),
-                cl::NDRange(workSize), cl::NDRange(groupSize), nullptr, &clEvent);
-        try
-        { clEvent.wait(); }
-        catch(const cl::Error& err)
+        char line[4096];
+        while (fgets(line, 4096, file) != nullptr)
         {
-            if (err.err() != CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST)
-                throw; // if other error
-            int eventStatus;
-            clEvent.getInfo(CL_EVENT_COMMAND_EXECUTION_STATUS, &eventStatus);
-            char strBuf[64];
-            snprintf(strBuf, 64, "Failed NDRangeKernel with code: %d", eventStatus);
-            throw MyException(strBuf);
+            const char* tabPos = ::strchr(line, '\t');
+            if (tabPos != nullptr &&
+                key.compare(0, std::string::npos, line, tabPos-line) != 0)
+                lines.push_back(line);
         }
+        fclose(file);
     }
+    char valuesBuf[128];
+    snprintf(valuesBuf, 128, "\t%u %llu %u %llu %.6g %.6g\n", entry.kitersNum,
+             (unsigned long long)entry.groupSize, entry.workFactor,
+             (unsigned long long)entry.kernelTime, entry.bandwidth, entry.perf);
+    lines.push_back(key + valuesBuf);
     
-    if (stopAllStressTestersByUser.load())
-    {
-        std::lock_guard<std::mutex> l(stdOutputMutex);
-        *outStream << "#" << id << " Exiting, because user stopped test." << std::endl;
-        handleOutput(id);
-        return;
+    const std::string tmpFilename = std::string(calibrationDBFile) + ".tmp";
+    file = fopen(tmpFilename.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+    bool good = true;
+    for (const std::string& line: lines)
+        good = good && fwrite(line.data(), 1, line.size(), file) == line.size();
+    good = (fclose(file) == 0) && good;
+    if (good && std::rename(tmpFilename.c_str(), calibrationDBFile) != 0)
+    {   // on Windows rename fails if destination exists
+        std::remove(calibrationDBFile);
+        good = (std::rename(tmpFilename.c_str(), calibrationDBFile) == 0);
     }
-    
-    // get results
-    if (!useInputAndOutput || (passItersNum&1) == 0)
-        clCmdQueue1.enqueueReadBuffer(clBuffer1, CL_TRUE, size_t(0), bufItemsNum<<2,
-                    toCompare);
-    else //
-        clCmdQueue1.enqueueReadBuffer(clBuffer2, CL_TRUE, size_t(0), bufItemsNum<<2,
-                    toCompare);
-    
+    if (!good)
+        std::remove(tmpFilename.c_str());
+    return good;
+}
+
+/*
+ * parallel program builder
+ */
+
+/* builds programs in worker pool in background (from separate thread),
+ * built programs can be taken in any order (mostly in order of building) */
+class ParallelProgramBuilder
+{
+private:
+    struct Slot
     {
-        std::lock_guard<std::mutex> l(stdOutputMutex);
-        *outStream << "#" << id << " Results for comparison has been generated." << std::endl;
-        handleOutput(id);
-    }
+        cl::Program program;
+        bool ready;
+        std::exception_ptr exception;
+    };
     
-    // print results
-    /*for (size_t i = 0; i < bufItemsNum; i++)
-        *outStream << "out=" << i << ":" << toCompare[i] << '\n';
-    outStream->flush();*/
+    std::mutex mutex;
+    std::condition_variable readyCond;
+    std::vector<Slot> slots;
+    std::function<cl::Program(cxuint)> buildFunc;
+    std::atomic<bool> cancelled;
+    std::thread thread;
     
-    initialized = true;
+    void buildAll();
+public:
+    ParallelProgramBuilder(cxuint programsNum,
+                const std::function<cl::Program(cxuint)>& buildFunc);
+    // cancels not started builds and waits for started builds
+    ~ParallelProgramBuilder();
+    
+    // waits for program, rethrows exception from building
+    cl::Program getProgram(cxuint index);
+};
+
+ParallelProgramBuilder::ParallelProgramBuilder(cxuint programsNum,
+            const std::function<cl::Program(cxuint)>& _buildFunc)
+        : slots(programsNum), buildFunc(_buildFunc), cancelled(false)
+{
+    for (Slot& slot: slots)
+        slot.ready = false;
+    thread = std::thread(&ParallelProgramBuilder::buildAll, this);
 }
-catch(...)
+
+ParallelProgramBuilder::~ParallelProgramBuilder()
 {
-    delete[] toCompare;
-    delete[] initialValues;
-    delete[] results;
-    throw;
+    cancelled.store(true);
+    thread.join();
 }
 
-GPUStressTester::~GPUStressTester()
+void ParallelProgramBuilder::buildAll()
 {
-    delete[] toCompare;
-    delete[] initialValues;
-    delete[] results;
+    getWorkerPool().runParts(slots.size(), [this](cxuint index)
+    {
+        cl::Program program;
+        std::exception_ptr exception;
+        if (!cancelled.load())
+        {
+            try
+            { program = buildFunc(index); }
+            catch(...)
+            { exception = std::current_exception(); }
+        }
+        std::lock_guard<std::mutex> l(mutex);
+        slots[index].program = program;
+        slots[index].exception = exception;
+        slots[index].ready = true;
+        readyCond.notify_all();
+    });
 }
 
-void GPUStressTester::buildKernel(cxuint thisKitersNum, cxuint thisBlocksNum,
-                bool alwaysPrintBuildLog, bool whenCalibrates)
-{   // freeing resources
-    clKernel = cl::Kernel();
-    clProgram = cl::Program();
-    
-    cl::Program::Sources clSources;
-    clSources.push_back(std::make_pair(clKernelSource, clKernelSourceSize));
-    clProgram = cl::Program(clContext, clSources);
+cl::Program ParallelProgramBuilder::getProgram(cxuint index)
+{
+    std::unique_lock<std::mutex> l(mutex);
+    readyCond.wait(l, [this, index]() { return slots[index].ready; });
+    if (slots[index].exception)
+        std::rethrow_exception(slots[index].exception);
+    return slots[index].program;
+}
+
+/* runs function in own thread, wait() rethrows exception from function.
+ * destructor waits for finish */
+class BackgroundTask
+{
+private:
+    std::exception_ptr exception;
+    std::thread thread;
+public:
+    explicit BackgroundTask(const std::function<void()>& func);
+    ~BackgroundTask();
     
-    char buildOptions[128];
-    try
-    {
-        snprintf(buildOptions, 128, "-DGROUPSIZE=" SIZE_T_SPEC
-                "U -DKITERSNUM=%uU -DBLOCKSNUM=%uU",
-                groupSize, thisKitersNum, thisBlocksNum);
-        clProgram.build(buildOptions);
-    }
-    catch(const cl::Error& error)
+    void wait();
+};
+
+BackgroundTask::BackgroundTask(const std::function<void()>& func)
+{
+    thread = std::thread([this, func]()
     {
-        printBuildLog();
-        throw;
-    }
-    if (alwaysPrintBuildLog)
-        printBuildLog();
-    clKernel = cl::Kernel(clProgram, "gpuStress");
-    
+        try
+        { func(); }
+        catch(...)
+        { exception = std::current_exception(); }
+    });
+}
+
+BackgroundTask::~BackgroundTask()
+{
+    if (thread.joinable())
+        thread.join();
+}
+
+void BackgroundTask::wait()
+{
+    if (thread.joinable())
+        thread.join();
+    if (exception)
+        std::rethrow_exception(exception);
+}
+
+/*
+ * results comparator
+ */
+
+typedef bool (*CompareWordsFunc)(const cl_uint* expected, const cl_uint* results, size_t n);
+
+#ifndef HAVE_SSE2
+static bool compareWordsScalar(const cl_uint* expected, const cl_uint* results, size_t n)
+{
+    return ::memcmp(expected, results, n<<2) == 0;
+}
+#else
+static bool compareWordsSSE2(const cl_uint* expected, const cl_uint* results, size_t n)
+{
+    const size_t n4 = n & ~size_t(3);
+    size_t i = 0;
+    while (i < n4)
+    {   // check after every 4 KB
+        const size_t end = std::min(n4, i+1024);
+        __m128i acc = _mm_setzero_si128();
+        for (; i < end; i += 4)
+            acc = _mm_or_si128(acc, _mm_xor_si128(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(expected+i)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(results+i))));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xffff)
+            return false;
+    }
+    for (; i < n; i++)
+        if (expected[i] != results[i])
+            return false;
+    return true;
+}
+#endif
+
+#ifdef HAVE_AVX2_TARGET
+__attribute__((target("avx2")))
+static bool compareWordsAVX2(const cl_uint* expected, const cl_uint* results, size_t n)
+{
+    const size_t n8 = n & ~size_t(7);
+    size_t i = 0;
+    while (i < n8)
+    {   // check after every 4 KB
+        const size_t end = std::min(n8, i+1024);
+        __m256i acc = _mm256_setzero_si256();
+        for (; i < end; i += 8)
+            acc = _mm256_or_si256(acc, _mm256_xor_si256(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(expected+i)),
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(results+i))));
+        if (!_mm256_testz_si256(acc, acc))
+            return false;
+    }
+    for (; i < n; i++)
+        if (expected[i] != results[i])
+            return false;
+    return true;
+}
+#endif
+
+static CompareWordsFunc chooseCompareWordsFunc()
+{
+#ifdef HAVE_AVX2_TARGET
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return compareWordsAVX2;
+#endif
+#ifdef HAVE_SSE2
+    return compareWordsSSE2;
+#else
+    return compareWordsScalar;
+#endif
+}
+
+static const CompareWordsFunc compareWords = chooseCompareWordsFunc();
+
+/* buffers larger than this are compared by worker threads */
+static const size_t parallelCompareMinSize = size_t(1)<<22; // in words
+
+/* returns true if results are equal to expected */
+static bool compareResults(const float* expectedF, const float* resultsF, size_t n)
+{
+    const cl_uint* expected = reinterpret_cast<const cl_uint*>(expectedF);
+    const cl_uint* results = reinterpret_cast<const cl_uint*>(resultsF);
+    if (n < parallelCompareMinSize)
+        return compareWords(expected, results, n);
+    
+    WorkerPool& pool = getWorkerPool();
+    if (pool.getThreadsNum() == 1)
+        return compareWords(expected, results, n);
+    
+    const cxuint partsNum = pool.getThreadsNum();
+    const size_t partSize = ((n + partsNum-1) / partsNum + 1023) & ~size_t(1023);
+    std::vector<char> partEqual(partsNum, 1);
+    pool.runParts(partsNum, [expected, results, n, partSize, &partEqual](cxuint part)
+    {
+        const size_t start = std::min(n, part*partSize);
+        const size_t end = std::min(n, start+partSize);
+        partEqual[part] = compareWords(expected+start, results+start, end-start);
+    });
+    return std::find(partEqual.begin(), partEqual.end(), 0) == partEqual.end();
+}
+
+static const float examplePoly[5] = 
+{ 4.43859953e+05,   1.13454169e+00,  -4.50175916e-06, -1.43865531e-12,   4.42133541e-18 };
+
+void TimingStats::addSample(cl_ulong sample)
+{
+    samples.insert(std::upper_bound(samples.begin(), samples.end(), sample), sample);
+}
+
+double TimingStats::getPercentile(double percent) const
+{
+    if (samples.empty())
+        return 0.0;
+    const double pos = double(samples.size()-1) *
+            std::max(0.0, std::min(percent, 100.0)) / 100.0;
+    const size_t index = size_t(pos);
+    if (index+1 >= samples.size())
+        return double(samples.back());
+    return double(samples[index]) + (pos-double(index)) *
+            (double(samples[index+1])-double(samples[index]));
+}
+
+double TimingStats::getMAD() const
+{
+    if (samples.empty())
+        return 0.0;
+    const double median = getMedian();
+    std::vector<double> deviations(samples.size());
+    for (size_t i = 0; i < samples.size(); i++)
+        deviations[i] = ::fabs(double(samples[i])-median);
+    std::sort(deviations.begin(), deviations.end());
+    const size_t n = deviations.size();
+    return (n&1) ? deviations[n>>1] : 0.5*(deviations[(n>>1)-1]+deviations[n>>1]);
+}
+
+double TimingStats::getMedianCI() const
+{
+    if (samples.size() < 2)
+        return 0.0;
+    /* sigma = 1.4826*MAD, standard error of median = 1.2533*sigma/sqrt(n) */
+    return 1.96 * 1.2533 * 1.4826 * getMAD() / ::sqrt(double(samples.size()));
+}
+
+bool TimingStats::isEnough(const TimingConfig& config) const
+{
+    if (samples.size() >= config.maxSamples)
+        return true;
+    if (samples.size() < std::max(1U, config.minSamples))
+        return false;
+    const double median = getMedian();
+    return median == 0.0 || getMedianCI() <= median*config.maxRelativeCI;
+}
+
+/* sampling plans for calibration and profiling */
+static const TimingConfig coarseTiming = { 1, 2, 6, 0.03 };
+static const TimingConfig fineTiming = { 1, 3, 8, 0.02 };
+static const TimingConfig preciseTiming = { 1, 3, 12, 0.01 };
+
+/* measure execution time of kernel (median of samples taken after warm-up runs).
+ * if initBuffer is given, it is copied to buffer before every run.
+ * returns zero if stopped by user */
+static cl_ulong profileKernelRuns(cl::CommandQueue& profCmdQueue, const cl::Kernel& kernel,
+            size_t workSize, size_t groupSize, const cl::Buffer* initBuffer,
+            const cl::Buffer& buffer, size_t bufferSize, const TimingConfig& timing,
+            TimingStats& stats)
+{
+    stats.clear();
+    for (cxuint k = 0; !stats.isEnough(timing); k++)
+    {
+        if (isPreparingStopped())
+            return 0; // if stopped by user
+        
+        if (initBuffer != nullptr)
+            profCmdQueue.enqueueCopyBuffer(*initBuffer, buffer, size_t(0), size_t(0),
+                    bufferSize);
+        
+        cl::Event profEvent;
+        profCmdQueue.enqueueNDRangeKernel(kernel, cl::NDRange(0),
+                cl::NDRange(workSize), cl::NDRange(groupSize), nullptr, &profEvent);
+        try
+        { profEvent.wait(); }
+        catch(const cl::Error& err)
+        {
+            if (err.err() != CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST)
+                throw; // if other error
+            int eventStatus;
+            profEvent.getInfo(CL_EVENT_COMMAND_EXECUTION_STATUS, &eventStatus);
+            char strBuf[64];
+            snprintf(strBuf, 64, "Failed NDRangeKernel with code: %d", eventStatus);
+            throw MyException(strBuf);
+        }
+        
+        cl_ulong eventStartTime, eventEndTime;
+        profEvent.getProfilingInfo(CL_PROFILING_COMMAND_START, &eventStartTime);
+        profEvent.getProfilingInfo(CL_PROFILING_COMMAND_END, &eventEndTime);
+        if (k >= timing.warmupRuns)
+            stats.addSample(eventEndTime-eventStartTime);
+    }
+    return cl_ulong(stats.getMedian()+0.5);
+}
+
+/* seed of initial values: from option or random (this same for all devices) */
+cl_ulong getRandomSeed()
+{
+    static const cl_ulong randomSeed = []() -> cl_ulong
+    {
+        if (randomSeedString == nullptr)
+        {
+            std::random_device randomDevice;
+            return (cl_ulong(randomDevice())<<32) | randomDevice();
+        }
+        char* end;
+        errno = 0;
+        const cl_ulong seed = ::strtoull(randomSeedString, &end, 0);
+        if (errno != 0 || end == randomSeedString || *end != 0)
+            throw MyException("Wrong random seed!");
+        return seed;
+    }();
+    return randomSeed;
+}
+
+/* types of initial values (valuesType in generate kernel) */
+enum : cxuint
+{
+    INITVALUES_STANDARD = 0,
+    INITVALUES_POLYWALKER,
+    INITVALUES_WALKING, // walking ones and zeros (memory tests)
+    INITVALUES_MODULO, // modulo-16 pattern (memory tests)
+    INITVALUES_RANDOM_BITS // raw random words (memory tests)
+};
+
+/* generate random initial values of test by worker threads. values are generated by
+ * Philox4x32-10 counter-based generator (4 values for counter), hence they do not
+ * depend on number of threads and are equal to values generated on device */
+static void generateInitialValues(float* values, size_t n, cxuint valuesType,
+            cl_ulong seed)
+{
+    const size_t chunkSize = size_t(1)<<18;
+    const cxuint chunksNum = (n + chunkSize-1) / chunkSize;
+    getWorkerPool().runParts(chunksNum, [values, n, chunkSize, valuesType,
+                seed](cxuint chunk)
+    {
+        const size_t start = chunk*chunkSize;
+        const size_t end = std::min(n, start+chunkSize);
+        if (valuesType == INITVALUES_WALKING || valuesType == INITVALUES_MODULO)
+        {   /* patterns for memory tests depend only on word address */
+            cl_uint* words = reinterpret_cast<cl_uint*>(values);
+            for (size_t i = start; i < end; i++)
+            {
+                const cl_uint addr = cl_uint(i);
+                if (valuesType == INITVALUES_WALKING) // ones at even, zeros at odd
+                    words[i] = (addr&1) ? ~(1U<<(addr&31)) : (1U<<(addr&31));
+                else
+                    words[i] = ((addr&15) == 0) ? 0U : 0xffffffffU;
+            }
+            return;
+        }
+        const cxuint lanesNum = 8; // counters processed at once (vectorizable)
+        for (size_t i = start; i < end; i += 4*lanesNum)
+        {
+            cl_uint x0[lanesNum], x1[lanesNum], x2[lanesNum], x3[lanesNum];
+            for (cxuint l = 0; l < lanesNum; l++)
+            {
+                x0[l] = cl_uint(i>>2) + l;
+                x1[l] = x2[l] = x3[l] = 0;
+            }
+            cl_uint k0 = cl_uint(seed), k1 = cl_uint(seed>>32);
+            for (cxuint r = 0; r < 10; r++)
+            {
+                for (cxuint l = 0; l < lanesNum; l++)
+                {
+                    const cl_ulong p0 = cl_ulong(0xD2511F53U)*x0[l];
+                    const cl_ulong p1 = cl_ulong(0xCD9E8D57U)*x2[l];
+                    const cl_uint y1 = x1[l], y3 = x3[l];
+                    x0[l] = cl_uint(p1>>32)^y1^k0;
+                    x1[l] = cl_uint(p1);
+                    x2[l] = cl_uint(p0>>32)^y3^k1;
+                    x3[l] = cl_uint(p0);
+                }
+                k0 += 0x9E3779B9U;
+                k1 += 0xBB67AE85U;
+            }
+            float u[4*lanesNum];
+            for (cxuint l = 0; l < lanesNum; l++)
+            {
+                u[4*l] = float(x0[l]>>8) * (1.0f/16777216.0f);
+                u[4*l+1] = float(x1[l]>>8) * (1.0f/16777216.0f);
+                u[4*l+2] = float(x2[l]>>8) * (1.0f/16777216.0f);
+                u[4*l+3] = float(x3[l]>>8) * (1.0f/16777216.0f);
+            }
+            const size_t count = std::min(size_t(4*lanesNum), end-i);
+            if (valuesType == INITVALUES_RANDOM_BITS)
+            {
+                cl_uint* words = reinterpret_cast<cl_uint*>(values+i);
+                for (size_t k = 0; k < count; k++)
+                {
+                    const cxuint l = k>>2;
+                    words[k] = (k&3)==0 ? x0[l] : (k&3)==1 ? x1[l] :
+                            (k&3)==2 ? x2[l] : x3[l];
+                }
+            }
+            else if (valuesType == INITVALUES_STANDARD)
+            {
+                for (size_t k = 0; k < count; k++)
+                    values[i+k] = (u[k]-0.5f)*0.04f;
+            }
+            else
+            {   /* data for polywalker */
+                for (size_t k = 0; k < count; k++)
+                    values[i+k] = u[k]*2e6f - 1e6f;
+            }
+        }
+    });
+}
+
+/* builtin kernel (test type): source, kind of arguments and initial values,
+ * floating point operations per element per kernel iteration and precision */
+struct BuiltinKernel
+{
+    const char* source;
+    bool usePolyWalker;
+    cxuint initValuesType;
+    cxuint flopsPerIter; // zero for memory tests (without kernel iterations)
+    bool useFP64; // requires cl_khr_fp64
+};
+
+/* returns builtin kernel (test type) */
+static BuiltinKernel getBuiltinKernel(cxuint builtinKernel)
+{
+    switch(builtinKernel)
+    {
+        case 0:
+            return { clKernel1Source, false, INITVALUES_STANDARD, 6, false };
+        case 1:
+            return { clKernel2Source, false, INITVALUES_STANDARD, 6, false };
+        case 2:
+            return { clKernelPWSource, true, INITVALUES_POLYWALKER, 8, false };
+        case 3:
+            return { clKernelPW2Source, true, INITVALUES_POLYWALKER, 8, false };
+        case 4:
+            return { clKernelMemWalkingSource, false, INITVALUES_WALKING, 0, false };
+        case 5:
+            return { clKernelMemInversionsSource, false, INITVALUES_RANDOM_BITS, 0, false };
+        case 6:
+            return { clKernelMemModuloSource, false, INITVALUES_MODULO, 0, false };
+        case 7:
+            return { clKernelMemRandomSource, false, INITVALUES_RANDOM_BITS, 0, false };
+        case 8:
+            return { clKernelDPSource, false, INITVALUES_STANDARD, 6, true };
+        case 9:
+            return { clKernelPWDPSource, true, INITVALUES_POLYWALKER, 8, true };
+        default:
+            throw MyException("Unsupported builtin kernel!");
+    }
+}
+
+int getTestVerificationMode(cxuint builtinKernel)
+{
+    if (builtinKernel >= 4 && builtinKernel <= 7 &&
+        (verificationMode == 0 || verificationMode == 3))
+        return 1; // memory tests: compare on device, without reading whole results
+    return verificationMode;
+}
+
+/* returns true if device can run builtin kernel (double precision tests) */
+static bool isBuiltinKernelSupported(const cl::Device& clDevice,
+            const BuiltinKernel& builtinKernel)
+{
+    if (!builtinKernel.useFP64)
+        return true;
+    std::string extensions;
+    clDevice.getInfo(CL_DEVICE_EXTENSIONS, &extensions);
+    // extensions are separated by spaces
+    for (size_t pos = 0; pos < extensions.size();)
+    {
+        const size_t end = std::min(extensions.find(' ', pos), extensions.size());
+        if (extensions.compare(pos, end-pos, "cl_khr_fp64") == 0)
+            return true;
+        pos = end+1;
+    }
+    return false;
+}
+
+/* throws exception if device can't run builtin kernel (double precision tests) */
+static void checkBuiltinKernelSupport(const cl::Device& clDevice,
+            const BuiltinKernel& builtinKernel)
+{
+    if (!isBuiltinKernelSupported(clDevice, builtinKernel))
+        throw MyException("Device doesn't support double precision (cl_khr_fp64) "
+                "required by test!");
+}
+
+bool isGPUStressConfigSupported(const cl::Device& clDevice, const GPUStressConfig& config)
+{
+    return isBuiltinKernelSupported(clDevice, getBuiltinKernel(config.builtinKernel));
+}
+
+/* prints message about device which is skipped, because can't run test */
+void printUnsupportedDevice(cxuint id, const cl::Device& clDevice)
+{
+    std::string deviceName;
+    clDevice.getInfo(CL_DEVICE_NAME, &deviceName);
+    std::lock_guard<std::mutex> l(stdOutputMutex);
+    *errStream << "#" << id << " " << trimSpaces(deviceName) << " skipped, because "
+            "device doesn't support double precision (cl_khr_fp64) required by test" <<
+            std::endl;
+    handleOutput(id);
+}
+
+/* parse memory target: megabytes or percent (with '%') of device global memory,
+ * returns target in bytes */
+cl_ulong parseMemoryTarget(const char* str, cl_ulong globalMemSize)
+{
+    char* end;
+    errno = 0;
+    const double value = ::strtod(str, &end);
+    if (errno != 0 || end == str || value <= 0.0)
+        throw MyException("Wrong memory target!");
+    if (*end == '%' && end[1] == 0)
+    {
+        if (value > 100.0)
+            throw MyException("Memory target can't be greater than 100%!");
+        return cl_ulong(double(globalMemSize)*value/100.0);
+    }
+    if (*end != 0)
+        throw MyException("Wrong memory target!");
+    return cl_ulong(value*1048576.0);
+}
+
+/* max number of mismatch indices returned by verification kernel */
+static const cxuint mismatchIndicesNum = 16;
+/* initial mismatch info: mismatches count (with padding), indices are 64-bit */
+static const cl_uint mismatchInfoInit[2] = { 0, 0 };
+/* streaming verification: size of chunk (in floats) and number of chunks in ring */
+static const size_t streamChunkSize = size_t(1)<<18;
+static const cxuint streamChunksNum = 4;
+
+GPUStressTester::GPUStressTester(cxuint _id, cl::Device& _clDevice,
+        const GPUStressConfig& config) :
+        id(_id), workFactor(config.workFactor),
+        blocksNum(config.blocksNum), passItersNum(config.passItersNum),
+        kitersNum(config.kitersNum), useInputAndOutput(config.inputAndOutput),
+        pipelineDepth(config.pipelineDepth)
+{
+    initialized = false;
+    failed = false;
+    pendingCallbacks = 0;
+    eventNanos = 0;
+    eventOverheadNanos = 0;
+    avgKernelNanos = 0.0;
+    usePinnedHostArrays = (usePinnedMemory != 0);
+    transferredBytes = 0.0;
+    transferNanos = 0;
+    usePolyWalker = false;
+    initValuesType = INITVALUES_STANDARD;
+    flopsPerIter = 0;
+    useFP64 = false;
+    // set clDevice, after because can fails and pointers to free must be set
+    clDevice = _clDevice;
+    
+    cl::Platform clPlatform;
+    clDevice.getInfo(CL_DEVICE_PLATFORM, &clPlatform);
+    
+    clPlatform.getInfo(CL_PLATFORM_NAME, &platformName);
+    platformName = trimSpaces(platformName);
+    clDevice.getInfo(CL_DEVICE_NAME, &deviceName);
+    deviceName = trimSpaces(deviceName);
+    
+    cl_uint maxComputeUnits;
+    if (config.groupSize == 0)
+        clDevice.getInfo(CL_DEVICE_MAX_WORK_GROUP_SIZE, &groupSize);
+    else // from config
+        groupSize = config.groupSize;
+    clDevice.getInfo(CL_DEVICE_MAX_COMPUTE_UNITS, &maxComputeUnits);
+    
+    if (::verificationMode < 0 || ::verificationMode > 3)
+        throw MyException("Unsupported verification mode!");
+    verificationMode = getTestVerificationMode(config.builtinKernel);
+    if (maxStopLatency <= 0)
+        throw MyException("Maximal stop latency must be positive!");
+    
+    if (memoryTargetString != nullptr)
+        applyMemoryTarget(maxComputeUnits);
+    poolSize = 0;
+    nextPoolRegion = 0;
+    poolCycles = 0;
+    if (memoryPoolString != nullptr)
+    {
+        cl_ulong globalMemSize;
+        clDevice.getInfo(CL_DEVICE_GLOBAL_MEM_SIZE, &globalMemSize);
+        poolSize = parseMemoryTarget(memoryPoolString, globalMemSize);
+    }
+    workSize = size_t(maxComputeUnits)*groupSize*workFactor;
+    bufItemsNum = (workSize<<4)*blocksNum;
+    {
+        cl_ulong maxAllocSize;
+        clDevice.getInfo(CL_DEVICE_MAX_MEM_ALLOC_SIZE, &maxAllocSize);
+        if ((cl_ulong(bufItemsNum)<<2) > maxAllocSize)
+            throw MyException("Buffer size exceeds maximal allocation size of device!");
+    }
+    
+    {
+        const BuiltinKernel builtinKernel = getBuiltinKernel(config.builtinKernel);
+        checkBuiltinKernelSupport(clDevice, builtinKernel);
+        clKernelSource = builtinKernel.source;
+        usePolyWalker = builtinKernel.usePolyWalker;
+        initValuesType = builtinKernel.initValuesType;
+        flopsPerIter = builtinKernel.flopsPerIter;
+        useFP64 = builtinKernel.useFP64;
+    }
+    clKernelSourceSize = ::strlen(clKernelSource);
+    if (flopsPerIter == 0) // memory tests: single pass over memory, no calibration
+        kitersNum = 1;
+    
+    {
+        double devMemReqs = 0.0;
+        if (poolSize != 0) // buffer sets are regions of memory pool
+            devMemReqs = double(poolSize)/(1048576.0);
+        else if (useInputAndOutput)
+            devMemReqs = double(bufItemsNum<<3)*pipelineDepth/(1048576.0);
+        else
+            devMemReqs = double(bufItemsNum<<2)*pipelineDepth/(1048576.0);
+        devMemReqs += double(bufItemsNum<<2)/(1048576.0); // initial values
+        if (verificationMode != 0) // results to compare in device memory
+            devMemReqs += double(bufItemsNum<<2)/(1048576.0);
+        
+        std::lock_guard<std::mutex> l(stdOutputMutex);
+        *outStream << "Preparing StressTester for\n  " <<
+                "#" << id << " " << platformName << ":" << deviceName <<
+                "\n    SetUp: workSize=" << workSize <<
+                ", memory=" << devMemReqs << " MB"
+                ", workFactor=" << workFactor <<
+                ", blocksNum=" << blocksNum <<
+                ",\n    computeUnits=" << maxComputeUnits <<
+                ", groupSize=" << groupSize <<
+                ", passIters=" << passItersNum <<
+                ", testType=" << config.builtinKernel <<
+                ",\n    inputAndOutput=" << (useInputAndOutput?"yes":"no") <<
+                ", pipelineDepth=" << pipelineDepth <<
+                ", verification=" << (verificationMode==0 ? "host" :
+                        (verificationMode==1 ? "device" :
+                        (verificationMode==2 ? "signatures" : "streaming"))) <<
+                ", hostMemory=" << (usePinnedHostArrays ? "pinned" : "pageable") <<
+                ",\n    randomSeed=" << getRandomSeed() <<
+                ", initialValues=" << (hostInitialValues != 0 ? "host" : "device") <<
+                std::endl;
+        handleOutput(id);
+    }
+    
+    if (checkStopping())
+        return;
+    
+    /* startup is pipelined: initial values are generated by host threads
+     * while buffers are allocated and programs are built */
+    std_time_point stageTime = SteadyClock::now();
+    const std_time_point startupTime = stageTime;
+    auto nextStageMillis = [&stageTime]()
+    {
+        const std_time_point now = SteadyClock::now();
+        const int64_t millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    now-stageTime).count();
+        stageTime = now;
+        return millis;
+    };
+    
+    cl_context_properties clContextProps[3];
+    clContextProps[0] = CL_CONTEXT_PLATFORM;
+    clContextProps[1] = reinterpret_cast<cl_context_properties>(clPlatform());
+    clContextProps[2] = 0;
+    clContext = cl::Context(clDevice, clContextProps);
+    
+    clCmdQueue1 = cl::CommandQueue(clContext, clDevice);
+    // profiling for measuring transfer bandwidth
+    clCmdQueue2 = cl::CommandQueue(clContext, clDevice, CL_QUEUE_PROFILING_ENABLE);
+    const int64_t contextMillis = nextStageMillis();
+    
+    int64_t generateMillis = 0;
+    std::unique_ptr<BackgroundTask> generateTask;
+    if (hostInitialValues != 0)
+    {
+        initialValues = allocHostArray();
+        generateTask.reset(new BackgroundTask([this, &generateMillis]()
+        {
+            const std_time_point generateStart = SteadyClock::now();
+            generateInitialValues(initialValues.get(), bufItemsNum, initValuesType,
+                        getRandomSeed());
+            generateMillis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        SteadyClock::now()-generateStart).count();
+        }));
+    }
+    
+    if (poolSize != 0)
+        createMemoryPool();
+    bufferSets.resize(pipelineDepth);
+    for (BufferSet& bufSet: bufferSets)
+    {
+        if (poolSize != 0)
+        {   // first regions of pool
+            const PoolRegion& region = takePoolRegion();
+            bufSet.clBuffer1 = region.buffer;
+            if (useInputAndOutput)
+                bufSet.clBuffer2 = takePoolRegion().buffer;
+            bufSet.clSignatureBuffer = region.clSignatureBuffer;
+        }
+        else
+        {
+            bufSet.clBuffer1 = cl::Buffer(clContext, CL_MEM_READ_WRITE, bufItemsNum<<2);
+            if (useInputAndOutput)
+                bufSet.clBuffer2 = cl::Buffer(clContext, CL_MEM_READ_WRITE,
+                            bufItemsNum<<2);
+        }
+        bufSet.tester = this;
+        bufSet.readCompleted = false;
+        bufSet.kernelCompleted = false;
+        bufSet.kernelStatus = CL_COMPLETE;
+        bufSet.pendingKernels = 0;
+        bufSet.readStatus = CL_COMPLETE;
+        if (verificationMode == 1)
+        {
+            bufSet.clMismatchBuffer = cl::Buffer(clContext, CL_MEM_READ_WRITE,
+                        sizeof(uint64_t)*(mismatchIndicesNum+1));
+            bufSet.mismatchInfo.resize(mismatchIndicesNum+1);
+        }
+        else if (verificationMode == 2)
+        {   /* sized for workSize groups, because group size can be reduced
+             * while building kernel */
+            if (poolSize == 0) // otherwise signature buffer of pool region
+                bufSet.clSignatureBuffer = cl::Buffer(clContext, CL_MEM_READ_WRITE,
+                            sizeof(cl_uint)*workSize);
+            bufSet.signatures.resize(workSize);
+        }
+        bufSet.passNum = 0;
+        bufSet.isExecuted = false;
+    }
+    const cl::Buffer& clBuffer1 = bufferSets[0].clBuffer1;
+    const cl::Buffer& clBuffer2 = bufferSets[0].clBuffer2;
+    
+    if (verificationMode == 0)
+    {   /* results of buffer sets are read asynchronously, hence separate arrays */
+        toCompare = allocHostArray();
+        for (BufferSet& bufSet: bufferSets)
+            bufSet.results = allocHostArray();
+    }
+    else // results to compare in device memory
+        clCompareBuffer = cl::Buffer(clContext, CL_MEM_READ_WRITE, bufItemsNum<<2);
+    if (verificationMode == 3)
+    {   /* results are compared in chunks, only small ring of chunks in host memory */
+        streamChunks.resize(streamChunksNum);
+        for (StreamChunk& chunk: streamChunks)
+        {
+            chunk.expected.reset(new float[streamChunkSize]);
+            chunk.results.reset(new float[streamChunkSize]);
+        }
+    }
+    /* keep initial values only in device memory */
+    clInitBuffer = cl::Buffer(clContext, CL_MEM_READ_WRITE, bufItemsNum<<2);
+    const int64_t buffersMillis = nextStageMillis();
+    
+    cl::Event generateEvent;
+    if (hostInitialValues == 0)
+    {   // generate initial values on device
+        cl::Program::Sources clSources;
+        clSources.push_back(std::make_pair(clGenerateKernelSource,
+                    ::strlen(clGenerateKernelSource)));
+        cl::Program generateProgram(clContext, clSources);
+        try
+        { generateProgram.build(""); }
+        catch(const cl::Error& error)
+        {
+            printBuildLog(generateProgram);
+            throw;
+        }
+        cl::Kernel generateKernel(generateProgram, "generateValues");
+        const cl_ulong seed = getRandomSeed();
+        generateKernel.setArg(0, cl_uint(bufItemsNum>>2));
+        generateKernel.setArg(1, cl_uint(seed));
+        generateKernel.setArg(2, cl_uint(seed>>32));
+        generateKernel.setArg(3, cl_uint(initValuesType));
+        generateKernel.setArg(4, clInitBuffer());
+        clCmdQueue2.enqueueNDRangeKernel(generateKernel, cl::NDRange(0),
+                cl::NDRange(bufItemsNum>>2), cl::NullRange, nullptr, &generateEvent);
+        clCmdQueue2.flush();
+    }
+    
+    if (verificationMode == 1)
+    {   /* results will be compared on device by verification kernel */
+        cl::Program::Sources clSources;
+        clSources.push_back(std::make_pair(clVerifyKernelSource,
+                    ::strlen(clVerifyKernelSource)));
+        clVerifyProgram = cl::Program(clContext, clSources);
+        char buildOptions[64];
+        snprintf(buildOptions, 64, "-DMISMATCHESNUM=%uU", mismatchIndicesNum);
+        try
+        { clVerifyProgram.build(buildOptions); }
+        catch(const cl::Error& error)
+        {
+            printBuildLog(clVerifyProgram);
+            throw;
+        }
+        clVerifyKernel = cl::Kernel(clVerifyProgram, "verifyResults");
+        clVerifyKernel.setArg(0, cl_ulong(bufItemsNum>>2));
+        clVerifyKernel.setArg(1, clCompareBuffer());
+    }
+    prebuildProgram();
+    const int64_t buildMillis = nextStageMillis();
+    
+    if (hostInitialValues == 0)
+    {
+        generateEvent.wait();
+        cl_ulong eventStartTime, eventEndTime;
+        generateEvent.getProfilingInfo(CL_PROFILING_COMMAND_START, &eventStartTime);
+        generateEvent.getProfilingInfo(CL_PROFILING_COMMAND_END, &eventEndTime);
+        generateMillis = (eventEndTime-eventStartTime)/1000000;
+    }
+    else
+        generateTask->wait();
+    const int64_t waitMillis = nextStageMillis();
+    if (hostInitialValues != 0)
+    {
+        cl::Event writeEvent;
+        clCmdQueue2.enqueueWriteBuffer(clInitBuffer, CL_TRUE, size_t(0), bufItemsNum<<2,
+                initialValues.get(), nullptr, &writeEvent);
+        cl_ulong eventStartTime, eventEndTime;
+        writeEvent.getProfilingInfo(CL_PROFILING_COMMAND_START, &eventStartTime);
+        writeEvent.getProfilingInfo(CL_PROFILING_COMMAND_END, &eventEndTime);
+        std::lock_guard<std::mutex> l(stdOutputMutex);
+        *outStream << "#" << id << " Initial values uploaded, transfer bandwidth: " <<
+                double(bufItemsNum<<2) / double(eventEndTime-eventStartTime) <<
+                " GB/s" << std::endl;
+        handleOutput(id);
+    }
+    initialValues.reset();
+    const int64_t uploadMillis = nextStageMillis();
+    
+    calibrateKernel();
+    preparedProgram = cl::Program(); // if not used
+    const int64_t calibrationMillis = nextStageMillis();
+    if (checkStopping())
+        return;
+    
+    bindKernels();
+    if (enqueueBenchmark != 0)
+        runEnqueueBenchmark();
+    
+    clCmdQueue1.enqueueCopyBuffer(clInitBuffer, clBuffer1, size_t(0), size_t(0),
+            bufItemsNum<<2);
+    
+    clKernel.setArg(0, cl_uint(workSize));
+    if (usePolyWalker)
+    {
+        clKernel.setArg(3, examplePoly[0]);
+        clKernel.setArg(4, examplePoly[1]);
+        clKernel.setArg(5, examplePoly[2]);
+        clKernel.setArg(6, examplePoly[3]);
+        clKernel.setArg(7, examplePoly[4]);
+    }
+    /* generate values to compare */
+    if (!useInputAndOutput)
+    {
+        clKernel.setArg(1, clBuffer1());
+        clKernel.setArg(2, clBuffer1());
+    }
+    
+    for (cxuint i = 0; i < passItersNum; i++)
+    {
+        if (isPreparingStopped())
+            break; // skip this
+        
+        if (useInputAndOutput)
+        {
+            if ((i&1) == 0)
+            {
+                clKernel.setArg(1, clBuffer1());
+                clKernel.setArg(2, clBuffer2());
+            }
+            else
+            {
+                clKernel.setArg(1, clBuffer2());
+                clKernel.setArg(2, clBuffer1());
+            }
+        }
+        cl::Event clEvent;
+        clCmdQueue1.enqueueNDRangeKernel(clKernel, cl::NDRange(0),
+                cl::NDRange(workSize), cl::NDRange(groupSize), nullptr, &clEvent);
+        try
+        { clEvent.wait(); }
+        catch(const cl::Error& err)
+        {
+            if (err.err() != CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST)
+                throw; // if other error
+            int eventStatus;
+            clEvent.getInfo(CL_EVENT_COMMAND_EXECUTION_STATUS, &eventStatus);
+            char strBuf[64];
+            snprintf(strBuf, 64, "Failed NDRangeKernel with code: %d", eventStatus);
+            throw MyException(strBuf);
+        }
+    }
+    
+    if (checkStopping())
+        return;
+    
+    // get results
+    if (verificationMode != 0)
+    {   // keep results to compare in device memory
+        clCmdQueue1.enqueueCopyBuffer(getResultsBuffer(bufferSets[0]), clCompareBuffer,
+                    size_t(0), size_t(0), bufItemsNum<<2);
+        if (verificationMode == 2)
+        {   // signatures of last kernel (its group size is final now)
+            goldenSignatures.resize(getGroupsNum());
+            clCmdQueue1.enqueueReadBuffer(bufferSets[0].clSignatureBuffer, CL_TRUE,
+                    size_t(0), sizeof(cxuint)*goldenSignatures.size(),
+                    goldenSignatures.data());
+        }
+        clCmdQueue1.finish();
+    }
+    else
+        clCmdQueue1.enqueueReadBuffer(getResultsBuffer(bufferSets[0]), CL_TRUE, size_t(0),
+                    bufItemsNum<<2, toCompare.get());
+    
+    {
+        const int64_t goldenMillis = nextStageMillis();
+        std::lock_guard<std::mutex> l(stdOutputMutex);
+        *outStream << "#" << id << " Results for comparison has been generated." << std::endl;
+        *outStream << "#" << id << " Startup times: context: " << contextMillis <<
+                " ms, buffers: " << buffersMillis << " ms, builds: " << buildMillis <<
+                " ms,\n    initial values: " << generateMillis << " ms (waited: " <<
+                waitMillis << " ms), upload: " << uploadMillis << " ms, calibration: " <<
+                calibrationMillis << " ms,\n    golden run: " << goldenMillis <<
+                " ms, total: " << std::chrono::duration_cast<std::chrono::milliseconds>(
+                    stageTime-startupTime).count() << " ms" << std::endl;
+        handleOutput(id);
+    }
+    
+    // print results
+    /*for (size_t i = 0; i < bufItemsNum; i++)
+        *outStream << "out=" << i << ":" << toCompare[i] << '\n';
+    outStream->flush();*/
+    
+    initialized = true;
+}
+
+GPUStressTester::~GPUStressTester()
+{
+    /* callbacks and non-blocking reads refer to buffer sets and host arrays,
+     * hence all commands must be finished before they are freed */
+    if (clCmdQueue1() != nullptr)
+        try
+        { clCmdQueue1.finish(); }
+        catch(...)
+        { } // ignore errors
+    if (clCmdQueue2() != nullptr)
+        try
+        { clCmdQueue2.finish(); }
+        catch(...)
+        { } // ignore errors
+    waitForPendingReads();
+}
+
+/* derive workFactor and blocksNum (and pipelineDepth, if buffer can't be greater than
+ * maximal allocation size) from memory target. buffers: pipelineDepth buffer sets,
+ * initial values and (if results are compared on device) results to compare */
+void GPUStressTester::applyMemoryTarget(cl_uint maxComputeUnits)
+{
+    cl_ulong globalMemSize, maxAllocSize;
+    clDevice.getInfo(CL_DEVICE_GLOBAL_MEM_SIZE, &globalMemSize);
+    clDevice.getInfo(CL_DEVICE_MAX_MEM_ALLOC_SIZE, &maxAllocSize);
+    const cl_ulong targetSize = parseMemoryTarget(memoryTargetString, globalMemSize);
+    
+    const cxuint buffersPerSet = useInputAndOutput ? 2 : 1;
+    const cxuint otherBuffers = (verificationMode != 0) ? 2 : 1;
+    // more buffer sets (up to 16) if single buffer would be too big
+    while (pipelineDepth < 16 &&
+           targetSize / (cl_ulong(pipelineDepth)*buffersPerSet + otherBuffers) >
+                maxAllocSize)
+        pipelineDepth++;
+    if (targetSize / (cl_ulong(pipelineDepth)*buffersPerSet + otherBuffers) > maxAllocSize)
+        throw MyException("Memory target is too big for maximal allocation size "
+                "even with 16 buffer sets!");
+    const cl_ulong bufSize = targetSize /
+                (cl_ulong(pipelineDepth)*buffersPerSet + otherBuffers);
+    // buffer size for workFactor=1 and blocksNum=1 (16 floats per work item)
+    const cl_ulong unitSize = cl_ulong(maxComputeUnits)*groupSize*64;
+    const cl_ulong unitsNum = bufSize / unitSize;
+    if (unitsNum == 0)
+        throw MyException("Memory target is too small!");
+    /* blocksNum (up to 16) is raised only if workFactor from config is too small */
+    if (unitsNum <= workFactor)
+    {
+        workFactor = cxuint(unitsNum);
+        blocksNum = 1;
+    }
+    else
+    {
+        blocksNum = cxuint(std::min(cl_ulong(16), unitsNum / workFactor));
+        workFactor = cxuint(unitsNum / blocksNum);
+    }
+    
+    std::lock_guard<std::mutex> l(stdOutputMutex);
+    *outStream << "#" << id << " Memory target: " << (targetSize/1048576) <<
+            " MB, maxAllocSize: " << (maxAllocSize/1048576) << " MB, workFactor=" <<
+            workFactor << ", blocksNum=" << blocksNum << ", pipelineDepth=" <<
+            pipelineDepth << std::endl;
+    handleOutput(id);
+}
+
+/* allocate memory pool as few buffers (not greater than maximal allocation size)
+ * divided to regions (sub-buffers) for buffers of buffer sets */
+void GPUStressTester::createMemoryPool()
+{
+    cl_ulong maxAllocSize;
+    cl_uint baseAddrAlign; // in bits
+    clDevice.getInfo(CL_DEVICE_MAX_MEM_ALLOC_SIZE, &maxAllocSize);
+    clDevice.getInfo(CL_DEVICE_MEM_BASE_ADDR_ALIGN, &baseAddrAlign);
+    const size_t alignment = std::max(size_t(1), size_t(baseAddrAlign>>3));
+    const size_t regionSize = bufItemsNum<<2;
+    const size_t regionStride = (regionSize + alignment-1) / alignment * alignment;
+    
+    cl_ulong remaining = poolSize;
+    while (remaining >= regionStride)
+    {
+        const cl_ulong regionsInBuffer = std::min(remaining,
+                    std::max(maxAllocSize, cl_ulong(regionSize))) / regionStride;
+        const size_t bufferSize = size_t(regionsInBuffer)*regionStride;
+        poolBuffers.push_back(cl::Buffer(clContext, CL_MEM_READ_WRITE, bufferSize));
+        for (cl_ulong i = 0; i < regionsInBuffer; i++)
+        {
+            cl_buffer_region region;
+            region.origin = size_t(i)*regionStride;
+            region.size = regionSize;
+            poolRegions.push_back(PoolRegion());
+            poolRegions.back().buffer = poolBuffers.back().createSubBuffer(
+                    CL_MEM_READ_WRITE, CL_BUFFER_CREATE_TYPE_REGION, &region);
+            if (verificationMode == 2)
+                poolRegions.back().clSignatureBuffer = cl::Buffer(clContext,
+                        CL_MEM_READ_WRITE, sizeof(cl_uint)*workSize);
+        }
+        remaining -= bufferSize;
+    }
+    if (poolRegions.size() < size_t(pipelineDepth)*(useInputAndOutput ? 2 : 1))
+        throw MyException("Memory pool is too small for buffer sets!");
+    
+    std::lock_guard<std::mutex> l(stdOutputMutex);
+    *outStream << "#" << id << " Memory pool: " << (poolSize/1048576) << " MB, buffers: " <<
+            poolBuffers.size() << ", regions: " << poolRegions.size() << std::endl;
+    handleOutput(id);
+}
+
+/* next region of memory pool (regions are taken in cyclic order) */
+const GPUStressTester::PoolRegion& GPUStressTester::takePoolRegion()
+{
+    const PoolRegion& region = poolRegions[nextPoolRegion++];
+    if (nextPoolRegion == poolRegions.size())
+    {
+        nextPoolRegion = 0;
+        poolCycles++;
+    }
+    return region;
+}
+
+/* move buffer set to next regions of memory pool. region is reused after all other
+ * regions, hence regions of executed buffer sets are not overwritten.
+ * kernels of region are already bound, hence no setArg is needed */
+void GPUStressTester::rotatePoolRegions(BufferSet& bufSet)
+{
+    const PoolRegion& region = takePoolRegion();
+    bufSet.clBuffer1 = region.buffer;
+    if (useInputAndOutput)
+        bufSet.clBuffer2 = takePoolRegion().buffer;
+    bufSet.clKernels[0] = region.clKernels[0];
+    bufSet.clKernels[1] = region.clKernels[1];
+    if (verificationMode == 2)
+        bufSet.clSignatureBuffer = region.clSignatureBuffer;
+}
+
+/* allocate host array for bufItemsNum floats. in pinned mode array is backed by
+ * CL_MEM_ALLOC_HOST_PTR buffer (results are still read from device buffers) */
+GPUStressTester::HostArray GPUStressTester::allocHostArray()
+{
+    if (!usePinnedHostArrays)
+        return HostArray(new float[bufItemsNum], HostArrayDeleter(this));
+    
+    PinnedHostArray pinnedArray;
+    pinnedArray.clBuffer = cl::Buffer(clContext, CL_MEM_READ_WRITE|CL_MEM_ALLOC_HOST_PTR,
+            bufItemsNum<<2);
+    pinnedArray.mapped = reinterpret_cast<float*>(clCmdQueue1.enqueueMapBuffer(
+            pinnedArray.clBuffer, CL_TRUE, CL_MAP_READ|CL_MAP_WRITE, size_t(0),
+            bufItemsNum<<2));
+    pinnedHostArrays.push_back(std::move(pinnedArray));
+    return HostArray(pinnedHostArrays.back().mapped, HostArrayDeleter(this));
+}
+
+void GPUStressTester::freeHostArray(float* array)
+{
+    if (array == nullptr)
+        return;
+    if (!usePinnedHostArrays)
+    {
+        delete[] array;
+        return;
+    }
+    for (auto it = pinnedHostArrays.begin(); it != pinnedHostArrays.end(); ++it)
+        if (it->mapped == array)
+        {
+            try
+            {
+                clCmdQueue1.enqueueUnmapMemObject(it->clBuffer, array);
+                clCmdQueue1.finish();
+            }
+            catch(...)
+            { } // ignore errors
+            pinnedHostArrays.erase(it);
+            return;
+        }
+}
+
+void GPUStressTester::addTransferTime(const cl::Event& clEvent, size_t bytes)
+{
+    cl_ulong eventStartTime, eventEndTime;
+    clEvent.getProfilingInfo(CL_PROFILING_COMMAND_START, &eventStartTime);
+    clEvent.getProfilingInfo(CL_PROFILING_COMMAND_END, &eventEndTime);
+    transferNanos += eventEndTime-eventStartTime;
+    transferredBytes += double(bytes);
+}
+
+/* build program for given parameters (can be called from many threads).
+ * if kitersNum is zero, program takes kitersNum as kernel argument */
+/* multiplier coprime with number of items (permutation of items in random address
+ * memory test), computed once instead of in every work-item */
+static cl_ulong memTestMultiplier(cl_ulong itemsNum)
+{
+    cl_ulong mul = 2654435761ULL % itemsNum;
+    for (;; mul++)
+    {   // find multiplier coprime with number of items
+        cl_ulong a = itemsNum, b = mul;
+        while (b != 0)
+        { const cl_ulong t = a % b; a = b; b = t; }
+        if (a == 1)
+            return mul;
+    }
+}
+
+cl::Program GPUStressTester::buildProgram(cxuint thisKitersNum, cxuint thisBlocksNum,
+                size_t thisGroupSize)
+{
+    char buildOptions[192];
+    int optsLen;
+    if (thisKitersNum != 0)
+        optsLen = snprintf(buildOptions, 192, "-DGROUPSIZE=" SIZE_T_SPEC
+                "U -DKITERSNUM=%uU -DBLOCKSNUM=%uU",
+                thisGroupSize, thisKitersNum, thisBlocksNum);
+    else // kitersNum will be passed as kernel argument
+        optsLen = snprintf(buildOptions, 192, "-DGROUPSIZE=" SIZE_T_SPEC
+                "U -DRUNTIME_KITERS=1 -DBLOCKSNUM=%uU", thisGroupSize, thisBlocksNum);
+    if (flopsPerIter == 0)
+    {   // memory tests: number of items and multiplier of item index
+        const cl_ulong itemsNum = cl_ulong(workSize)*thisBlocksNum;
+        optsLen += snprintf(buildOptions+optsLen, 192-optsLen,
+                " -DITEMSNUM=%lluUL -DITEMMUL=%lluUL", (unsigned long long)itemsNum,
+                (unsigned long long)memTestMultiplier(itemsNum));
+    }
+    if (verificationMode == 2)
+    {   // start of reduction of signatures (half of power of two >= groupSize)
+        size_t redStart = 1;
+        while (redStart < thisGroupSize)
+            redStart <<= 1;
+        snprintf(buildOptions+optsLen, 192-optsLen,
+                " -DSIGNATURES=1 -DSIGREDSTART=" SIZE_T_SPEC "U", redStart>>1);
+    }
+    
+    std::string cacheKey, cacheFilename;
+    if (programCacheDir != nullptr)
+    {   /* key: platform, device, driver version, source hash and build options */
+        std::string driverVersion;
+        clDevice.getInfo(CL_DRIVER_VERSION, &driverVersion);
+        char hashBuf[24];
+        snprintf(hashBuf, 24, "%016llx", (unsigned long long)getSourceHash());
+        cacheKey = platformName + '\n' + deviceName + '\n' + driverVersion + '\n' +
+                hashBuf + '\n' + buildOptions;
+        snprintf(hashBuf, 24, "%016llx",
+                 (unsigned long long)fnv1a64(cacheKey.data(), cacheKey.size()));
+        cacheFilename = std::string(programCacheDir) + "/gpustress-" + hashBuf + ".bin";
+        
+        std::vector<unsigned char> binary;
+        if (loadProgramBinary(cacheFilename, cacheKey, binary))
+        {
+            try
+            {
+                const cl::Program::Binaries binaries(1,
+                        std::make_pair(binary.data(), binary.size()));
+                cl::Program program(clContext, std::vector<cl::Device>(1, clDevice),
+                        binaries);
+                program.build(buildOptions);
+                return program;
+            }
+            catch(const cl::Error& error)
+            {   // fallback to building from source
+                std::lock_guard<std::mutex> l(stdOutputMutex);
+                *errStream << "#" << id << " Cached program binary has been rejected (" <<
+                        error.what() << "), building from source" << std::endl;
+                handleOutput(id);
+            }
+        }
+    }
+    
+    cl::Program::Sources clSources;
+    clSources.push_back(std::make_pair(clKernelCommonSource,
+                ::strlen(clKernelCommonSource)));
+    clSources.push_back(std::make_pair(clKernelSource, clKernelSourceSize));
+    cl::Program program(clContext, clSources);
+    try
+    { program.build(buildOptions); }
+    catch(const cl::Error& error)
+    {
+        printBuildLog(program);
+        throw;
+    }
+    
+    if (!cacheFilename.empty())
+    {
+        std::vector<size_t> binarySizes;
+        program.getInfo(CL_PROGRAM_BINARY_SIZES, &binarySizes);
+        if (binarySizes.size() == 1 && binarySizes[0] != 0)
+        {
+            std::vector<unsigned char> binary(binarySizes[0]);
+            unsigned char* binaryPtr = binary.data();
+            if (clGetProgramInfo(program(), CL_PROGRAM_BINARIES, sizeof(unsigned char*),
+                        &binaryPtr, nullptr) != CL_SUCCESS ||
+                !storeProgramBinary(cacheFilename, cacheKey, binary))
+            {
+                std::lock_guard<std::mutex> l(stdOutputMutex);
+                *errStream << "#" << id << " Can't store program binary in cache" <<
+                        std::endl;
+                handleOutput(id);
+            }
+        }
+    }
+    return program;
+}
+
+/* set kernel from built program, returns maximal group size for this kernel */
+size_t GPUStressTester::useProgram(const cl::Program& program)
+{
+    clProgram = program;
+    clKernel = cl::Kernel(clProgram, "gpuStress");
+    if (verificationMode == 2) // for calibration and generating results to compare
+        clKernel.setArg(getSignaturesArgIndex(), bufferSets[0].clSignatureBuffer());
+    size_t maxGroupSize;
+    clKernel.getWorkGroupInfo(clDevice, CL_KERNEL_WORK_GROUP_SIZE, &maxGroupSize);
+    return maxGroupSize;
+}
+
+void GPUStressTester::buildKernel(cxuint thisKitersNum, cxuint thisBlocksNum,
+                bool alwaysPrintBuildLog)
+{   // freeing resources
+    clKernel = cl::Kernel();
+    clProgram = cl::Program();
+    
+    cl::Program program;
+    if (preparedProgram() != nullptr && preparedKitersNum == thisKitersNum &&
+        preparedGroupSize == groupSize && thisBlocksNum == blocksNum)
+        program = preparedProgram; // built while initial values have been generated
+    else
+        program = buildProgram(thisKitersNum, thisBlocksNum, groupSize);
+    preparedProgram = cl::Program();
+    if (alwaysPrintBuildLog)
+        printBuildLog(program);
+    
     // fixing groupSize and workSize if needed and if possible
-    size_t newGroupSize;
-    clKernel.getWorkGroupInfo(clDevice, CL_KERNEL_WORK_GROUP_SIZE, &newGroupSize);
+    const size_t newGroupSize = useProgram(program);
     if (groupSize > newGroupSize)
     {   // fix it
         cxuint shifts = 0;
@@ -644,182 +1991,367 @@ void GPUStressTester::buildKernel(cxuint thisKitersNum, cxuint thisBlocksNum,
         workFactor <<= shifts;
         {
             std::lock_guard<std::mutex> l(stdOutputMutex);
-            if (whenCalibrates)
-                *outStream << std::endl;
             *outStream << "Fixed groupSize for\n  " <<
                 "#" << id << " " << platformName << ":" << deviceName <<
                 "\n    SetUp: workFactor=" << workFactor <<
                 ", groupSize=" << groupSize << std::endl;
-            if (whenCalibrates)
-            {
-                *outStream << "  Calibration progress:";
-                outStream->flush();
-            }
             handleOutput(id);
         }
-        buildKernel(thisKitersNum, thisBlocksNum, alwaysPrintBuildLog, whenCalibrates);
+        buildKernel(thisKitersNum, thisBlocksNum, alwaysPrintBuildLog);
     }
 }
 
-void GPUStressTester::calibrateKernel()
+/* build program which will be used first by calibration (or test) */
+void GPUStressTester::prebuildProgram()
 {
-    cxuint bestKitersNum = 1;
-    double bestBandwidth = 0.0;
-    double bestPerf = 0.0;
-    cl_ulong bestKernelTime = CL_ULONG_MAX;
-    cl_ulong kernelTime = 0;
-    cl::CommandQueue profCmdQueue(clContext, clDevice, CL_QUEUE_PROFILING_ENABLE);
+    preparedKitersNum = kitersNum;
+    preparedGroupSize = groupSize;
+    if (kitersNum == 0 && calibrationDBFile != nullptr)
+    {   // stored calibration will be validated first
+        CalibrationEntry entry;
+        if (findCalibrationEntry(getCalibrationKey(), entry) &&
+            size_t(entry.workFactor)*entry.groupSize == size_t(workFactor)*groupSize)
+        {
+            preparedKitersNum = entry.kitersNum;
+            preparedGroupSize = entry.groupSize;
+        }
+    }
+    if (preparedKitersNum == 0 && specializedCalibration != 0)
+        return; // calibration builds programs concurrently
+    preparedProgram = buildProgram(preparedKitersNum, blocksNum, preparedGroupSize);
+}
+
+uint64_t GPUStressTester::getSourceHash() const
+{
+    const uint64_t hash = fnv1a64(clKernelCommonSource, ::strlen(clKernelCommonSource));
+    return fnv1a64(clKernelSource, clKernelSourceSize, hash);
+}
+
+/* key of calibration: device identity and test configuration */
+std::string GPUStressTester::getCalibrationKey() const
+{
+    std::string driverVersion;
+    clDevice.getInfo(CL_DRIVER_VERSION, &driverVersion);
+    char configBuf[160];
+    snprintf(configBuf, 160, "%016llx|" SIZE_T_SPEC "|" SIZE_T_SPEC "|%u|%u|%u|%d",
+             (unsigned long long)getSourceHash(), workSize, groupSize, workFactor,
+             blocksNum, cxuint(useInputAndOutput), verificationMode);
+    std::string key = platformName + '|' + deviceName + '|' + driverVersion + '|' +
+            configBuf;
+    for (char& c: key)
+        if (c == '\t' || c == '\n' || c == '\r')
+            c = ' ';
+    return key;
+}
+
+/* set arguments of current kernel and measure its execution time.
+ * returns zero if stopped by user */
+cl_ulong GPUStressTester::profileKernel(cl::CommandQueue& profCmdQueue,
+            const TimingConfig& timing, cxuint* samplesNum)
+{
+    const cl::Buffer& clBuffer1 = bufferSets[0].clBuffer1;
+    const cl::Buffer& clBuffer2 = bufferSets[0].clBuffer2;
+    clKernel.setArg(0, cl_uint(workSize));
+    clKernel.setArg(1, clBuffer1());
+    if (useInputAndOutput)
+        clKernel.setArg(2, clBuffer2());
+    else
+        clKernel.setArg(2, clBuffer1());
     
-    const bool profileKernelAfterBuilt = (kitersNum != 0);
-    if (kitersNum == 0)
+    if (usePolyWalker)
     {
-        if (useInputAndOutput)
-            clCmdQueue1.enqueueWriteBuffer(clBuffer1, CL_TRUE, size_t(0), bufItemsNum<<2,
-                    initialValues);
-        
+        clKernel.setArg(3, examplePoly[0]);
+        clKernel.setArg(4, examplePoly[1]);
+        clKernel.setArg(5, examplePoly[2]);
+        clKernel.setArg(6, examplePoly[3]);
+        clKernel.setArg(7, examplePoly[4]);
+    }
+    // ensure always this same input data for kernel
+    TimingStats stats;
+    const cl_ulong kernelTime = profileKernelRuns(profCmdQueue, clKernel, workSize,
+            groupSize, useInputAndOutput ? nullptr : &clInitBuffer, clBuffer1,
+            bufItemsNum<<2, timing, stats);
+    if (samplesNum != nullptr)
+        *samplesNum = stats.getSamplesNum() + timing.warmupRuns;
+    return kernelTime;
+}
+
+/* golden-section search of kitersNum (1-40) with the best score (score is assumed
+ * to be unimodal). evaluate profiles given kitersNum values (which are not yet in
+ * scores) and returns false if stopped. search ends when bracket has at most three
+ * values or when scores of both inner points are within tolerance (flat curve).
+ * returns false if stopped, otherwise sets the best found kitersNum and number
+ * of variants used by search */
+static bool searchBestKiters(std::map<cxuint, double>& scores,
+            const std::function<bool(const std::vector<cxuint>&)>& evaluate,
+            double tolerance, cxuint& bestKiters, cxuint& variantsNum)
+{
+    const double invPhi = 0.6180339887498949;
+    std::set<cxuint> visited;
+    auto ensureScores = [&scores, &evaluate, &visited](const std::vector<cxuint>& list)
+    {
+        std::vector<cxuint> missing;
+        for (cxuint k: list)
+        {
+            visited.insert(k);
+            if (scores.find(k) == scores.end())
+                missing.push_back(k);
+        }
+        return missing.empty() || evaluate(missing);
+    };
+    cxuint lo = 1, hi = 40;
+    cxuint c = hi - cxuint(::round(invPhi*(hi-lo)));
+    cxuint d = lo + cxuint(::round(invPhi*(hi-lo)));
+    if (!ensureScores({ c, d }))
+        return false;
+    bool flat = false;
+    while (hi - lo > 2)
+    {
+        const double scoreC = scores[c], scoreD = scores[d];
+        if (::fabs(scoreC-scoreD) <= tolerance*std::max(scoreC, scoreD))
         {
+            flat = true; // bracket is flat within tolerance
+            break;
+        }
+        if (scoreC >= scoreD)
+        {   // maximum is between lo and d
+            hi = d;
+            d = c;
+            c = hi - cxuint(::round(invPhi*(hi-lo)));
+            if (c >= d)
+                c = d-1;
+        }
+        else
+        {   // maximum is between c and hi
+            lo = c;
+            c = d;
+            d = lo + cxuint(::round(invPhi*(hi-lo)));
+            if (d <= c)
+                d = c+1;
+        }
+        if (hi - lo <= 2)
+            break;
+        if (!ensureScores({ c, d }))
+            return false;
+    }
+    if (!flat)
+    {   // remaining values of bracket
+        std::vector<cxuint> list;
+        for (cxuint k = lo; k <= hi; k++)
+            list.push_back(k);
+        if (!ensureScores(list))
+            return false;
+    }
+    bestKiters = *visited.begin();
+    for (cxuint k: visited)
+        if (scores[k] > scores[bestKiters])
+            bestKiters = k;
+    variantsNum = visited.size();
+    return true;
+}
+
+/* profile kernels for all kitersNum from list and update the best score.
+ * if specialized calibration is enabled, programs are built concurrently and
+ * profiled as soon as they are built, otherwise kitersNum is passed to
+ * current (runtime kitersNum) kernel. returns false if stopped by user */
+bool GPUStressTester::profileKitersVariants(const std::vector<cxuint>& kitersList,
+            const TimingConfig& timing, cxuint plannedNum, cl::CommandQueue& profCmdQueue,
+            cxuint& profiledNum, cxuint& kernelRunsNum, KitersScore& best,
+            std::map<cxuint, double>& scores)
+{
+    const size_t buildGroupSize = groupSize;
+    std::unique_ptr<ParallelProgramBuilder> programBuilder;
+    if (specializedCalibration != 0)
+        programBuilder.reset(new ParallelProgramBuilder(kitersList.size(),
+            [this, &kitersList, buildGroupSize](cxuint index)
+            { return buildProgram(kitersList[index], blocksNum, buildGroupSize); }));
+    
+    for (cxuint index = 0; index < kitersList.size(); index++)
+    {
+        const cxuint curKitersNum = kitersList[index];
+        if (isPreparingStopped())
+            return false;
+        
+        if ((profiledNum%5) == 0)
+        {   /* print progress of calibration (whole line, because devices can be
+             * calibrated concurrently) */
             std::lock_guard<std::mutex> l(stdOutputMutex);
-            *outStream << "Calibrating Kernel for\n  " <<
-                "#" << id << " " << platformName << ":" << deviceName << "..." << std::endl;
-            *outStream << "  Calibration progress:";
-            outStream->flush();
+            *outStream << "  #" << id << " Calibration progress: " <<
+                    (profiledNum*100/plannedNum) << "%" << std::endl;
             handleOutput(id);
         }
+        if (programBuilder)
+        {
+            const cl::Program program = programBuilder->getProgram(index);
+            // if group size must be changed, build again with fixing
+            if (groupSize != buildGroupSize || useProgram(program) < groupSize)
+                buildKernel(curKitersNum, blocksNum, false);
+        }
+        else
+            clKernel.setArg(getKitersArgIndex(), cl_uint(curKitersNum));
         
-        try
+        /* runtime kitersNum kernel is already warmed up by previous variants */
+        TimingConfig thisTiming = timing;
+        if (!programBuilder && profiledNum != 0)
+            thisTiming.warmupRuns = 0;
+        cxuint runsNum = 0;
+        const cl_ulong currentTime = profileKernel(profCmdQueue, thisTiming, &runsNum);
+        if (isPreparingStopped())
+            return false; // if stopped by user
+        profiledNum++;
+        kernelRunsNum += runsNum;
+        
+        double currentBandwidth;
+        currentBandwidth = 2.0*4.0*double(bufItemsNum) / double(currentTime);
+        const double currentPerf = double(flopsPerIter)*double(curKitersNum)*
+                double(bufItemsNum) / double(currentTime);
+        scores[curKitersNum] = currentBandwidth*currentPerf;
+        
+        if (currentBandwidth*currentPerf > best.bandwidth*best.perf)
         {
-        for (cxuint curKitersNum = 1; curKitersNum <= 40; curKitersNum++)
+            best.kitersNum = curKitersNum;
+            best.perf = currentPerf;
+            best.bandwidth = currentBandwidth;
+            best.kernelTime = currentTime;
+        }
+    }
+    return true;
+}
+
+void GPUStressTester::calibrateKernel()
+{
+    cxuint bestKitersNum = 1;
+    double bestBandwidth = 0.0;
+    double bestPerf = 0.0;
+    cl_ulong bestKernelTime = CL_ULONG_MAX;
+    cl_ulong kernelTime = 0;
+    cl::CommandQueue profCmdQueue(clContext, clDevice, CL_QUEUE_PROFILING_ENABLE);
+    const cl::Buffer& clBuffer1 = bufferSets[0].clBuffer1;
+    
+    bool profileKernelAfterBuilt = (kitersNum != 0);
+    cl_ulong runtimeKernelTime = 0; // kernel time of runtime kitersNum variant
+    std::string calibrationKey;
+    bool useStoredCalibration = false;
+    if (kitersNum == 0 && calibrationDBFile != nullptr)
+    {   /* use stored calibration if validation kernel time is near to stored time */
+        calibrationKey = getCalibrationKey();
+        CalibrationEntry entry;
+        if (findCalibrationEntry(calibrationKey, entry) &&
+            size_t(entry.workFactor)*entry.groupSize == size_t(workFactor)*groupSize)
         {
-            if (stopAllStressTestersByUser.load())
-            {
-                std::lock_guard<std::mutex> l(stdOutputMutex);
-                *outStream << std::endl;
-                handleOutput(id);
-                return;
-            }
-            
-            if (((curKitersNum-1)%5) == 0)
-            {   /* print progress of calibration */
-                std::lock_guard<std::mutex> l(stdOutputMutex);
-                *outStream << " " << ((curKitersNum-1)*100/40) << "%";
-                outStream->flush();
-                handleOutput(id);
-            }
-            buildKernel(curKitersNum, blocksNum, false, true);
-            
-            clKernel.setArg(0, cl_uint(workSize));
-            clKernel.setArg(1, clBuffer1());
+            groupSize = entry.groupSize;
+            workFactor = entry.workFactor;
             if (useInputAndOutput)
-                clKernel.setArg(2, clBuffer2());
-            else
-                clKernel.setArg(2, clBuffer1());
-            
-            if (usePolyWalker)
-            {
-                clKernel.setArg(3, examplePoly[0]);
-                clKernel.setArg(4, examplePoly[1]);
-                clKernel.setArg(5, examplePoly[2]);
-                clKernel.setArg(6, examplePoly[3]);
-                clKernel.setArg(7, examplePoly[4]);
-            }
-            
-            cl_ulong kernelTimes[5];
-            for (cxuint k = 0; k < 5; k++)
-            {
-                if (stopAllStressTestersByUser.load())
-                {
-                    std::lock_guard<std::mutex> l(stdOutputMutex);
-                    *outStream << std::endl;
-                    handleOutput(id);
-                    return; // if stopped by user
-                }
-                
-                if (!useInputAndOutput) // ensure always this same input data for kernel
-                    clCmdQueue1.enqueueWriteBuffer(clBuffer1, CL_TRUE, size_t(0),
-                            bufItemsNum<<2, initialValues);
-                
-                cl::Event profEvent;
-                profCmdQueue.enqueueNDRangeKernel(clKernel, cl::NDRange(0),
-                        cl::NDRange(workSize), cl::NDRange(groupSize), nullptr, &profEvent);
-                try
-                { profEvent.wait(); }
-                catch(const cl::Error& err)
-                {
-                    if (err.err() != CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST)
-                        throw; // if other error
-                    int eventStatus;
-                    profEvent.getInfo(CL_EVENT_COMMAND_EXECUTION_STATUS, &eventStatus);
-                    char strBuf[64];
-                    snprintf(strBuf, 64, "Failed NDRangeKernel with code: %d", eventStatus);
-                    throw MyException(strBuf);
-                }
-                
-                cl_ulong eventStartTime, eventEndTime;
-                profEvent.getProfilingInfo(CL_PROFILING_COMMAND_START, &eventStartTime);
-                profEvent.getProfilingInfo(CL_PROFILING_COMMAND_END, &eventEndTime);
-                kernelTimes[k] = eventEndTime-eventStartTime;
-            }
-            
-            // sort kernels times
-            for (cxuint k = 0; k < 5; k++)
             {
-                for (cxuint l = k+1; l < 5; l++)
-                    if (kernelTimes[k]>kernelTimes[l])
-                        std::swap(kernelTimes[k], kernelTimes[l]);
-                //*outStream << "SortedTime: " << kernelTimes[k] << std::endl;
+                clCmdQueue1.enqueueCopyBuffer(clInitBuffer, clBuffer1, size_t(0),
+                        size_t(0), bufItemsNum<<2);
+                clCmdQueue1.finish();
             }
+            buildKernel(entry.kitersNum, blocksNum, false);
+            const cl_ulong validTime = profileKernel(profCmdQueue, preciseTiming);
+            if (isPreparingStopped())
+                return;
+            const double deviation = ::fabs(double(validTime)-double(entry.kernelTime)) /
+                    double(entry.kernelTime);
+            useStoredCalibration = (deviation*100.0 <= double(calibrationTolerance));
             
-            cxuint acceptedToAvg = 1;
-            for (; acceptedToAvg < 5; acceptedToAvg++)
-                if (double(kernelTimes[acceptedToAvg]-kernelTimes[0]) >
-                            double(kernelTimes[0])*0.07)
-                    break;
-            //*outStream << "acceptedToAvg: " << acceptedToAvg << std::endl;
-            const cl_ulong currentTime =
-                std::accumulate(kernelTimes, kernelTimes+acceptedToAvg, 0ULL)/acceptedToAvg;
-            /* *outStream << "avg is: " << currentTime << std::endl;
-            *outStream << "..." << std::endl;*/
-            
-            double currentBandwidth;
-            currentBandwidth = 2.0*4.0*double(bufItemsNum) / double(currentTime);
-            double currentPerf;
-            if (!usePolyWalker)
-                currentPerf = 2.0*3.0*double(curKitersNum)*double(bufItemsNum) /
-                        double(currentTime);
-            else
-                currentPerf = 8.0*double(curKitersNum)*double(bufItemsNum) /
-                        double(currentTime);
-            
-            if (currentBandwidth*currentPerf > bestBandwidth*bestPerf)
+            std::lock_guard<std::mutex> l(stdOutputMutex);
+            *outStream << "Stored calibration for\n  " <<
+                    "#" << id << " " << platformName << ":" << deviceName << "\n"
+                    "  KitersNum: " << entry.kitersNum << ", Bandwidth: " <<
+                    entry.bandwidth << " GB/s, Performance: " << entry.perf <<
+                    " " << getPerfUnit() << ", deviation: " << (deviation*100.0) << "%" <<
+                    (useStoredCalibration ? "" : ", recalibrating") << std::endl;
+            handleOutput(id);
+            if (useStoredCalibration)
             {
-                bestKitersNum = curKitersNum;
-                bestPerf = currentPerf;
-                bestBandwidth = currentBandwidth;
-                bestKernelTime = currentTime;
+                bestKitersNum = entry.kitersNum;
+                kernelTime = validTime;
             }
         }
-        } // try/catch
-        catch(...)
+    }
+    
+    if (!useStoredCalibration && kitersNum == 0)
+    {
+        if (useInputAndOutput)
+        {
+            clCmdQueue1.enqueueCopyBuffer(clInitBuffer, clBuffer1, size_t(0), size_t(0),
+                    bufItemsNum<<2);
+            clCmdQueue1.finish();
+        }
+        
         {
             std::lock_guard<std::mutex> l(stdOutputMutex);
-            *outStream << std::endl;
+            *outStream << "Calibrating Kernel for\n  " <<
+                "#" << id << " " << platformName << ":" << deviceName << "..." << std::endl;
             handleOutput(id);
-            throw;
         }
         
+        KitersScore best = { 1, 0.0, 0.0, CL_ULONG_MAX };
+        cxuint profiledNum = 0;
+        cxuint kernelRunsNum = 0;
+        if (specializedCalibration == 0) // single program for all kitersNum
+            buildKernel(0, blocksNum, false);
+        
+        /* score is product of bandwidth and performance */
+        std::map<cxuint, double> scores;
+        const double tolerance = double(calibrationTolerance)/100.0;
+        cxuint searchKiters = 0, searchVariantsNum = 0;
+        if (exhaustiveCalibration != 0)
+        {   // check all kitersNum
+            std::vector<cxuint> kitersList;
+            for (cxuint curKitersNum = 1; curKitersNum <= 40; curKitersNum++)
+                kitersList.push_back(curKitersNum);
+            if (!profileKitersVariants(kitersList, fineTiming, 40, profCmdQueue,
+                        profiledNum, kernelRunsNum, best, scores))
+                return; // if stopped by user
+            // compare with golden-section search on already measured scores
+            searchBestKiters(scores, [](const std::vector<cxuint>&) { return true; },
+                    tolerance, searchKiters, searchVariantsNum);
+        }
+        else
+        {   // golden-section search (about 10 variants)
+            if (!searchBestKiters(scores, [this, &profCmdQueue, &profiledNum,
+                        &kernelRunsNum, &best, &scores](const std::vector<cxuint>& list)
+                    { return profileKitersVariants(list, fineTiming, 10, profCmdQueue,
+                            profiledNum, kernelRunsNum, best, scores); },
+                    tolerance, searchKiters, searchVariantsNum))
+                return; // if stopped by user
+        }
+        
+        if (specializedCalibration == 0)
+        {   // measure runtime variant for best kitersNum to compare with specialized
+            clKernel.setArg(getKitersArgIndex(), cl_uint(best.kitersNum));
+            runtimeKernelTime = profileKernel(profCmdQueue, preciseTiming);
+            if (isPreparingStopped())
+                return; // if stopped by user
+        }
+        
+        bestKitersNum = best.kitersNum;
+        bestBandwidth = best.bandwidth;
+        bestPerf = best.perf;
+        bestKernelTime = best.kernelTime;
         {   /* if choosen we compile real code */
             std::lock_guard<std::mutex> l(stdOutputMutex);
-            *outStream << " 100%" << std::endl;
             *outStream << "Kernel calibrated for\n  " <<
                     "#" << id << " " << platformName << ":" << deviceName << "\n"
                     "  BestKitersNum: " << bestKitersNum << ", Bandwidth: " << bestBandwidth <<
-                    " GB/s, Performance: " << bestPerf << " GFLOPS" << std::endl;
+                    " GB/s, Performance: " << bestPerf << " " << getPerfUnit() << "\n"
+                    "  Profiled variants: " << profiledNum << ", kernel runs: " <<
+                    kernelRunsNum << std::endl;
+            if (exhaustiveCalibration != 0)
+                *outStream << "  Golden-section search: kitersNum: " << searchKiters <<
+                        ", score: " << (100.0*scores[searchKiters]/
+                            (best.bandwidth*best.perf)) << "% of best, variants: " <<
+                        searchVariantsNum << std::endl;
             handleOutput(id);
         }
         
         kernelTime = bestKernelTime;
+        // specialized program must be profiled if calibrated with runtime kitersNum
+        profileKernelAfterBuilt = (specializedCalibration == 0);
     }
-    else
+    else if (!useStoredCalibration)
     {
         bestKitersNum = kitersNum;
         std::lock_guard<std::mutex> l(stdOutputMutex);
@@ -827,104 +2359,68 @@ void GPUStressTester::calibrateKernel()
         handleOutput(id);
     }
     
-    if (stopAllStressTestersByUser.load())
+    if (isPreparingStopped())
         return;
     kitersNum = bestKitersNum;
-    buildKernel(kitersNum, blocksNum, true, false);
-    
-    if (profileKernelAfterBuilt)
-    {
-        if (useInputAndOutput)
-            clCmdQueue1.enqueueWriteBuffer(clBuffer1, CL_TRUE, size_t(0), bufItemsNum<<2,
-                    initialValues);
-        
-        clKernel.setArg(0, cl_uint(workSize));
-        clKernel.setArg(1, clBuffer1());
-        if (useInputAndOutput)
-            clKernel.setArg(2, clBuffer2());
-        else
-            clKernel.setArg(2, clBuffer1());
-        
-        if (usePolyWalker)
-        {
-            clKernel.setArg(3, examplePoly[0]);
-            clKernel.setArg(4, examplePoly[1]);
-            clKernel.setArg(5, examplePoly[2]);
-            clKernel.setArg(6, examplePoly[3]);
-            clKernel.setArg(7, examplePoly[4]);
-        }
-        
-        cl_ulong kernelTimes[5];
-        for (cxuint k = 0; k < 5; k++)
-        {
-            if (stopAllStressTestersByUser.load())
-                return; // if stopped by user
-            
-            if (!useInputAndOutput) // ensure always this same input data for kernel
-                clCmdQueue1.enqueueWriteBuffer(clBuffer1, CL_TRUE, size_t(0),
-                        bufItemsNum<<2, initialValues);
-            
-            cl::Event profEvent;
-            profCmdQueue.enqueueNDRangeKernel(clKernel, cl::NDRange(0),
-                    cl::NDRange(workSize), cl::NDRange(groupSize), nullptr, &profEvent);
-            try
-            { profEvent.wait(); }
-            catch(const cl::Error& err)
-            {
-                if (err.err() != CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST)
-                    throw; // if other error
-                int eventStatus;
-                profEvent.getInfo(CL_EVENT_COMMAND_EXECUTION_STATUS, &eventStatus);
-                char strBuf[64];
-                snprintf(strBuf, 64, "Failed NDRangeKernel with code: %d", eventStatus);
-                throw MyException(strBuf);
-            }
-            
-            cl_ulong eventStartTime, eventEndTime;
-            profEvent.getProfilingInfo(CL_PROFILING_COMMAND_START, &eventStartTime);
-            profEvent.getProfilingInfo(CL_PROFILING_COMMAND_END, &eventEndTime);
-            kernelTimes[k] = eventEndTime-eventStartTime;
-        }
-        
-        // sort kernels times
-        for (cxuint k = 0; k < 5; k++)
+    if (useStoredCalibration)
+        printBuildLog(clProgram); // keep program built for validation
+    else
+        buildKernel(kitersNum, blocksNum, true);
+    
+    if (profileKernelAfterBuilt)
+    {
+        if (useInputAndOutput)
         {
-            for (cxuint l = k+1; l < 5; l++)
-                if (kernelTimes[k]>kernelTimes[l])
-                    std::swap(kernelTimes[k], kernelTimes[l]);
-            //*outStream << "SortedTime: " << kernelTimes[k] << std::endl;
+            clCmdQueue1.enqueueCopyBuffer(clInitBuffer, clBuffer1, size_t(0), size_t(0),
+                    bufItemsNum<<2);
+            clCmdQueue1.finish();
         }
         
-        cxuint acceptedToAvg = 1;
-        for (; acceptedToAvg < 5; acceptedToAvg++)
-            if (double(kernelTimes[acceptedToAvg]-kernelTimes[0]) >
-                        double(kernelTimes[0])*0.07)
-                break;
-        //*outStream << "acceptedToAvg: " << acceptedToAvg << std::endl;
-        kernelTime = std::accumulate(kernelTimes, kernelTimes+acceptedToAvg, 0ULL)/acceptedToAvg;
+        kernelTime = profileKernel(profCmdQueue, preciseTiming);
+        if (isPreparingStopped())
+            return; // if stopped by user
         
         double currentBandwidth;
         currentBandwidth = 2.0*4.0*double(bufItemsNum) / double(kernelTime);
-        double currentPerf;
-        if (!usePolyWalker)
-            currentPerf = 2.0*3.0*double(kitersNum)*double(bufItemsNum) /
-                    double(kernelTime);
-        else
-            currentPerf = 8.0*double(kitersNum)*double(bufItemsNum) /
-                    double(kernelTime);
+        const double currentPerf = double(flopsPerIter)*double(kitersNum)*
+                double(bufItemsNum) / double(kernelTime);
         {
             std::lock_guard<std::mutex> l(stdOutputMutex);
             *outStream << "Kernel performance for\n  " <<
                     "#" << id << " " << platformName << ":" << deviceName << "\n"
                     "  KitersNum: " << kitersNum << ", Bandwidth: " << currentBandwidth <<
-                    " GB/s, Performance: " << currentPerf << " GFLOPS" << std::endl;
+                    " GB/s";
+            if (flopsPerIter != 0)
+                *outStream << ", Performance: " << currentPerf << " " <<
+                        getPerfUnit();
+            *outStream << std::endl;
+            if (runtimeKernelTime != 0 && kernelTime != 0)
+                *outStream << "  Runtime kitersNum kernel throughput: " <<
+                    (100.0*double(kernelTime)/double(runtimeKernelTime)) <<
+                    "% of specialized kernel" << std::endl;
+            handleOutput(id);
+        }
+        bestBandwidth = currentBandwidth;
+        bestPerf = currentPerf;
+    }
+    
+    if (!calibrationKey.empty() && !useStoredCalibration)
+    {   // store calibration with time of specialized kernel
+        const CalibrationEntry entry = { kitersNum, groupSize, workFactor,
+                kernelTime, bestBandwidth, bestPerf };
+        if (!storeCalibrationEntry(calibrationKey, entry))
+        {
+            std::lock_guard<std::mutex> l(stdOutputMutex);
+            *errStream << "#" << id << " Can't store calibration in database" <<
+                    std::endl;
             handleOutput(id);
         }
     }
     
     // determine how many iterations can be queued at same time
+    avgKernelNanos = double(kernelTime);
     if (kernelTime != 0)
-        stepsPerWait = ::ceil(3e8 / double(kernelTime));
+        stepsPerWait = ::ceil(double(maxStopLatency)*1e6 / double(kernelTime));
     else // force 1000 if kernelTime is zero
         stepsPerWait = 1000;
     
@@ -954,10 +2450,10 @@ void GPUStressTester::calibrateKernel()
     }
 }
 
-void GPUStressTester::printBuildLog()
+void GPUStressTester::printBuildLog(const cl::Program& program)
 {
     std::string buildLog;
-    clProgram.getBuildInfo(clDevice, CL_PROGRAM_BUILD_LOG, &buildLog);
+    program.getBuildInfo(clDevice, CL_PROGRAM_BUILD_LOG, &buildLog);
     std::lock_guard<std::mutex> l(stdOutputMutex);
     *outStream << "Program build log:\n  " <<
             platformName << ":" << deviceName << "\n:--------------------\n" <<
@@ -975,14 +2471,10 @@ void GPUStressTester::printStatus(cxuint passNum)
                 stdCurrentTime-lastTime).count();
     lastTime = stdCurrentTime;
     
-    double bandwidth, perf;
-    bandwidth = 2.0*10.0*4.0*double(passItersNum)*double(bufItemsNum) / double(nanos);
-    if (!usePolyWalker)
-        perf = 2.0*10.0*3.0*double(kitersNum)*double(passItersNum)*double(bufItemsNum)
-                / double(nanos);
-    else
-        perf = 10.0*8.0*double(kitersNum)*double(passItersNum)*double(bufItemsNum)
-                / double(nanos);
+    const double bandwidth = 2.0*10.0*4.0*double(passItersNum)*double(bufItemsNum) /
+            double(nanos);
+    const double perf = 10.0*double(flopsPerIter)*double(kitersNum)*
+            double(passItersNum)*double(bufItemsNum) / double(nanos);
     
     const int64_t startMillis = std::max(int64_t(0),
         std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -992,11 +2484,96 @@ void GPUStressTester::printStatus(cxuint passNum)
              cxuint((startMillis/60000)%60), cxuint((startMillis/1000)%60),
              cxuint(startMillis%1000));
     
+    // bandwidth of reading results from device
+    const double transferBandwidth = (transferNanos != 0) ?
+            transferredBytes / double(transferNanos) : 0.0;
+    transferredBytes = 0.0;
+    transferNanos = 0;
+    // host time of waiting for events per pass
+    const double eventMicros = double(eventNanos)/10000.0;
+    eventNanos = 0;
+    // host time of event management (callbacks registration, releases) per pass
+    const double eventOverheadMicros = double(eventOverheadNanos)/10000.0;
+    eventOverheadNanos = 0;
+    
     std::lock_guard<std::mutex> l(stdOutputMutex);
     *outStream << "#" << id << " " << platformName << ":" << deviceName <<
             " passed PASS #" << passNum << "\n"
-            "Approx. bandwidth: " << bandwidth << " GB/s, "
-            "Approx. perf: " << perf << " GFLOPS, elapsed: " << timeStrBuf << std::endl;
+            "Approx. bandwidth: " << bandwidth << " GB/s, ";
+    if (flopsPerIter != 0)
+        *outStream << "Approx. perf: " << perf << " " << getPerfUnit() << ", ";
+    *outStream << "elapsed: " << timeStrBuf << "\n"
+            "Transfer bandwidth: " << transferBandwidth << " GB/s, "
+            "Event waits: " << eventMicros << " us/pass, "
+            "Event overhead: " << eventOverheadMicros << " us/pass, "
+            "Queued kernels: " << stepsPerWait;
+    if (!poolRegions.empty())
+        *outStream << ", Memory pool cycles: " << poolCycles;
+    *outStream << std::endl;
+    handleOutput(id);
+}
+
+/* accumulate mismatches from part of results which starts at offset */
+void GPUStressTester::addMismatches(MismatchStats& stats, const float* expectedF,
+            const float* resultsF, size_t n, size_t offset)
+{
+    const cl_uint* expected = reinterpret_cast<const cl_uint*>(expectedF);
+    const cl_uint* results = reinterpret_cast<const cl_uint*>(resultsF);
+    for (size_t i = 0; i < n; i++)
+        if (expected[i] != results[i])
+        {
+            if (stats.mismatchesNum == 0)
+            {
+                stats.index[0] = offset+i;
+                stats.expected[0] = expected[i];
+                stats.result[0] = results[i];
+            }
+            stats.index[1] = offset+i;
+            stats.expected[1] = expected[i];
+            stats.result[1] = results[i];
+            stats.mismatchesNum++;
+            stats.xorBits |= expected[i]^results[i];
+        }
+}
+
+void GPUStressTester::printMismatchReport(const float* expected, const float* results)
+{
+    MismatchStats stats = { 0, { 0, 0 }, { 0, 0 }, { 0, 0 }, 0 };
+    addMismatches(stats, expected, results, bufItemsNum, 0);
+    printMismatchReport(stats);
+}
+
+/* print where results mismatches: first and last mismatch (with workitem, group,
+ * block and byte address in buffer), number of mismatches and mismatching bits */
+void GPUStressTester::printMismatchReport(const MismatchStats& stats)
+{
+    std::lock_guard<std::mutex> l(stdOutputMutex);
+    *errStream << "#" << id << " Mismatch report: mismatches: " << stats.mismatchesNum <<
+            " of " << bufItemsNum << " floats" << std::endl;
+    if (stats.mismatchesNum == 0)
+    {
+        handleOutput(id);
+        return;
+    }
+    /* each workitem processes 16 floats (4 float4's) in block */
+    const char* names[2] = { "First", "Last" };
+    for (cxuint k = 0; k < 2; k++)
+    {
+        const size_t index = stats.index[k];
+        const size_t itemIndex = index>>4;
+        const size_t workItem = itemIndex % workSize;
+        char strBuf[256];
+        snprintf(strBuf, 256, "  %s mismatch at " SIZE_T_SPEC " (address=0x%llx): "
+                "workItem=" SIZE_T_SPEC ", group=" SIZE_T_SPEC ", block=" SIZE_T_SPEC
+                ", component=%u, expected=%08x, result=%08x, xor=%08x", names[k], index,
+                (unsigned long long)(index)<<2, workItem, workItem/groupSize,
+                itemIndex/workSize, cxuint(index&15), stats.expected[k], stats.result[k],
+                stats.expected[k]^stats.result[k]);
+        *errStream << strBuf << "\n";
+    }
+    char strBuf[64];
+    snprintf(strBuf, 64, "  Mismatching bits (OR of xors): %08x", stats.xorBits);
+    *errStream << strBuf << std::endl;
     handleOutput(id);
 }
 
@@ -1016,282 +2593,657 @@ void GPUStressTester::throwFailedComputations(cxuint passNum)
     throw MyException(strBuf);
 }
 
+bool GPUStressTester::checkStopping()
+{
+    if (stopAllStressTestersIfFail.load())
+    {
+        std::lock_guard<std::mutex> l(stdOutputMutex);
+        *outStream << "#" << id << " Exiting, because some device failed." << std::endl;
+        handleOutput(id);
+        return true;
+    }
+    if (stopAllStressTestersByUser.load())
+    {
+        std::lock_guard<std::mutex> l(stdOutputMutex);
+        *outStream << "#" << id << " Exiting, because user stopped test." << std::endl;
+        handleOutput(id);
+        return true;
+    }
+    return false;
+}
+
+static void checkEventStatus(const cl::Event& clEvent)
+{
+    int eventStatus;
+    clEvent.getInfo(CL_EVENT_COMMAND_EXECUTION_STATUS, &eventStatus);
+    if (eventStatus < 0)
+    {
+        char strBuf[64];
+        snprintf(strBuf, 64, "Failed NDRangeKernel with code: %d", eventStatus);
+        throw MyException(strBuf);
+    }
+}
+
+/* create kernel with bound arguments except buffers */
+cl::Kernel GPUStressTester::createBoundKernel(const cl::Buffer& signatureBuffer)
+{
+    cl::Kernel kernel(clProgram, "gpuStress");
+    kernel.setArg(0, cl_uint(workSize));
+    if (usePolyWalker)
+    {
+        kernel.setArg(3, examplePoly[0]);
+        kernel.setArg(4, examplePoly[1]);
+        kernel.setArg(5, examplePoly[2]);
+        kernel.setArg(6, examplePoly[3]);
+        kernel.setArg(7, examplePoly[4]);
+    }
+    if (verificationMode == 2)
+        kernel.setArg(getSignaturesArgIndex(), signatureBuffer());
+    return kernel;
+}
+
+/* set buffers to kernels (second kernel swapped in inputAndOutput) */
+void GPUStressTester::bindKernelBuffers(cl::Kernel* kernels, const cl::Buffer& buffer1,
+            const cl::Buffer& buffer2)
+{
+    if (!useInputAndOutput)
+    {
+        kernels[0].setArg(1, buffer1());
+        kernels[0].setArg(2, buffer1());
+    }
+    else
+    {
+        kernels[0].setArg(1, buffer1());
+        kernels[0].setArg(2, buffer2());
+        kernels[1].setArg(1, buffer2());
+        kernels[1].setArg(2, buffer1());
+    }
+}
+
+/* create kernels with bound arguments for every buffer set and direction
+ * (or for every region of memory pool), hence no setArg is needed while
+ * queueing kernels */
+void GPUStressTester::bindKernels()
+{
+    const cxuint kernelsNum = useInputAndOutput ? 2 : 1;
+    for (size_t r = 0; r < poolRegions.size(); r++)
+    {   // region is paired with next region (in order of taking regions)
+        PoolRegion& region = poolRegions[r];
+        for (cxuint dir = 0; dir < kernelsNum; dir++)
+            region.clKernels[dir] = createBoundKernel(region.clSignatureBuffer);
+        bindKernelBuffers(region.clKernels, region.buffer,
+                poolRegions[(r+1) % poolRegions.size()].buffer);
+    }
+    for (BufferSet& bufSet: bufferSets)
+    {
+        if (!poolRegions.empty())
+        {   // kernels of region which is used by buffer set
+            for (const PoolRegion& region: poolRegions)
+                if (region.buffer() == bufSet.clBuffer1())
+                {
+                    bufSet.clKernels[0] = region.clKernels[0];
+                    bufSet.clKernels[1] = region.clKernels[1];
+                }
+            continue;
+        }
+        for (cxuint dir = 0; dir < kernelsNum; dir++)
+            bufSet.clKernels[dir] = createBoundKernel(bufSet.clSignatureBuffer);
+        bindKernelBuffers(bufSet.clKernels, bufSet.clBuffer1, bufSet.clBuffer2);
+    }
+}
+
+/* measure host time of queueing kernels: with setArg before every kernel
+ * (swapping buffers) and with bound kernels */
+void GPUStressTester::runEnqueueBenchmark()
+{
+    const cxuint kernelsNum = 64;
+    const BufferSet& bufSet = bufferSets[0];
+    clKernel.setArg(0, cl_uint(workSize));
+    if (usePolyWalker)
+    {
+        clKernel.setArg(3, examplePoly[0]);
+        clKernel.setArg(4, examplePoly[1]);
+        clKernel.setArg(5, examplePoly[2]);
+        clKernel.setArg(6, examplePoly[3]);
+        clKernel.setArg(7, examplePoly[4]);
+    }
+    double throughputs[2];
+    for (cxuint mode = 0; mode < 2; mode++)
+    {
+        clCmdQueue1.finish();
+        const std_time_point benchStartTime = SteadyClock::now();
+        for (cxuint i = 0; i < kernelsNum; i++)
+        {
+            if (mode == 0)
+            {
+                if (useInputAndOutput && (i&1) != 0)
+                {
+                    clKernel.setArg(1, bufSet.clBuffer2());
+                    clKernel.setArg(2, bufSet.clBuffer1());
+                }
+                else
+                {
+                    clKernel.setArg(1, bufSet.clBuffer1());
+                    clKernel.setArg(2, useInputAndOutput ? bufSet.clBuffer2() :
+                            bufSet.clBuffer1());
+                }
+                clCmdQueue1.enqueueNDRangeKernel(clKernel, cl::NDRange(0),
+                        cl::NDRange(workSize), cl::NDRange(groupSize));
+            }
+            else
+                clCmdQueue1.enqueueNDRangeKernel(
+                        bufSet.clKernels[useInputAndOutput ? (i&1) : 0], cl::NDRange(0),
+                        cl::NDRange(workSize), cl::NDRange(groupSize));
+        }
+        const int64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                SteadyClock::now()-benchStartTime).count();
+        throughputs[mode] = (nanos != 0) ? double(kernelsNum)*1e9/double(nanos) : 0.0;
+        clCmdQueue1.finish();
+    }
+    
+    std::lock_guard<std::mutex> l(stdOutputMutex);
+    *outStream << "#" << id << " Enqueue throughput: with setArg: " << throughputs[0] <<
+            " kernels/s, bound kernels: " << throughputs[1] << " kernels/s" << std::endl;
+    handleOutput(id);
+}
+
+/* returns true if all kernels for this buffer set has been queued */
+bool GPUStressTester::enqueueExecution(BufferSet& bufSet)
+{
+    if (!poolRegions.empty()) // every pass in other part of device memory
+        rotatePoolRegions(bufSet);
+    /* reset input by copying initial values in device memory
+     * (this buffer set is already checked, so it can be overwritten) */
+    clCmdQueue1.enqueueCopyBuffer(clInitBuffer, bufSet.clBuffer1, size_t(0), size_t(0),
+            bufItemsNum<<2);
+    
+    /* kernels still queued in other buffer sets count to stop latency:
+     * wait for the oldest passes while budget of queued kernels is exceeded */
+    cxuint queuedKernels = 0;
+    {
+        const std_time_point waitStartTime = SteadyClock::now();
+        std::unique_lock<std::mutex> l(readMutex);
+        bufSet.kernelStatus = CL_COMPLETE; // previous pass already checked
+        while (true)
+        {
+            const BufferSet* oldestSet = nullptr;
+            queuedKernels = 0;
+            for (const BufferSet& otherSet: bufferSets)
+                if (&otherSet != &bufSet && otherSet.isExecuted &&
+                    !otherSet.kernelCompleted)
+                {
+                    queuedKernels += passItersNum;
+                    if (oldestSet == nullptr || otherSet.passNum < oldestSet->passNum)
+                        oldestSet = &otherSet;
+                }
+            if (oldestSet == nullptr || queuedKernels < stepsPerWait)
+                break;
+            readCond.wait(l, [oldestSet]() { return oldestSet->kernelCompleted; });
+        }
+        eventNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                SteadyClock::now()-waitStartTime).count();
+    }
+    bufSet.enqueueTime = SteadyClock::now();
+    
+    /* every kernel has event with status callback, because failure of kernel
+     * doesn't have to be propagated to later commands. two slots are reused
+     * (waiting for previous kernel), last kernel has own event */
+    cl::Event kernelEvents[2];
+    cxuint prevSlot = 0;
+    cxuint stepsAfterWait = queuedKernels;
+    for (cxuint i = 0; i < passItersNum; i++)
+    {
+        if (stopAllStressTestersIfFail.load() || stopAllStressTestersByUser.load())
+            return false;
+        // kernels with already bound buffers (swapped in inputAndOutput mode)
+        const cl::Kernel& boundKernel = bufSet.clKernels[useInputAndOutput ? (i&1) : 0];
+        stepsAfterWait++;
+        const bool waitNow = (i != 0 && stepsAfterWait >= stepsPerWait);
+        if (waitNow)
+            stepsAfterWait = 0;
+        cl::Event* clEvent = (i+1 == passItersNum) ? &bufSet.lastEvent :
+                &kernelEvents[prevSlot^1];
+        if (clEvent != &bufSet.lastEvent)
+        {   // release event of kernel before previous
+            const std_time_point releaseStartTime = SteadyClock::now();
+            *clEvent = cl::Event();
+            eventOverheadNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    SteadyClock::now()-releaseStartTime).count();
+        }
+        clCmdQueue1.enqueueNDRangeKernel(boundKernel, cl::NDRange(0),
+                cl::NDRange(workSize), cl::NDRange(groupSize), nullptr, clEvent);
+        if (clEvent != &bufSet.lastEvent)
+            watchKernelEvent(bufSet, *clEvent);
+        if (waitNow)
+        {   /* wait for previous ndrange kernel and ensure fluent working */
+            const std_time_point waitStartTime = SteadyClock::now();
+            try
+            { kernelEvents[prevSlot].wait(); }
+            catch(const cl::Error& err)
+            {
+                if (err.err() != CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST)
+                    throw; // if other error
+                checkEventStatus(kernelEvents[prevSlot]);
+            }
+            eventNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    SteadyClock::now()-waitStartTime).count();
+        }
+        prevSlot ^= 1;
+    }
+    
+    {   /* status of last kernel will be delivered by callback */
+        const std_time_point callbackStartTime = SteadyClock::now();
+        {
+            std::lock_guard<std::mutex> l(readMutex);
+            bufSet.kernelCompleted = false;
+            pendingCallbacks++;
+        }
+        try
+        { bufSet.lastEvent.setCallback(CL_COMPLETE, notifyKernelCompleted, &bufSet); }
+        catch(...)
+        {
+            std::lock_guard<std::mutex> l(readMutex);
+            pendingCallbacks--;
+            throw;
+        }
+        eventOverheadNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                SteadyClock::now()-callbackStartTime).count();
+    }
+    
+    if (verificationMode == 1)
+    {   /* compare results on device just after last kernel */
+        clCmdQueue1.enqueueWriteBuffer(bufSet.clMismatchBuffer, CL_FALSE, size_t(0),
+                sizeof(mismatchInfoInit), mismatchInfoInit);
+        clVerifyKernel.setArg(2, getResultsBuffer(bufSet)());
+        clVerifyKernel.setArg(3, bufSet.clMismatchBuffer());
+        clCmdQueue1.enqueueNDRangeKernel(clVerifyKernel, cl::NullRange,
+                cl::NDRange(workSize), cl::NullRange, nullptr, &bufSet.verifyEvent);
+    }
+    enqueueReadResults(bufSet);
+    return true;
+}
+
+/* flow controller: fed by completion of every pass (callback of its last kernel),
+ * keeps kernels queued in all buffer sets within maximal stop latency.
+ * kernel time is smoothed by exponential moving average */
+void GPUStressTester::updateStepsPerWait(const BufferSet& bufSet)
+{
+    // kernels of pass can't start before they are queued and before previous pass
+    const std_time_point passStartTime = std::max(bufSet.enqueueTime, lastPassEndTime);
+    lastPassEndTime = bufSet.completedTime;
+    if (bufSet.completedTime <= passStartTime)
+        return;
+    const double kernelNanos = double(std::chrono::duration_cast<
+            std::chrono::nanoseconds>(bufSet.completedTime-passStartTime).count()) /
+            double(passItersNum);
+    avgKernelNanos = (avgKernelNanos != 0.0) ?
+            avgKernelNanos*0.75 + kernelNanos*0.25 : kernelNanos;
+    if (avgKernelNanos <= 0.0)
+        return;
+    const double newStepsPerWait = ::ceil(double(maxStopLatency)*1e6 / avgKernelNanos);
+    // at least two: while waiting for previous, next kernel is executed
+    stepsPerWait = cxuint(std::max(2.0, std::min(newStepsPerWait, 100000.0)));
+}
+
+void CL_CALLBACK GPUStressTester::notifyReadCompleted(cl_event clEvent, cl_int status,
+                void* data)
+{
+    BufferSet* bufSet = reinterpret_cast<BufferSet*>(data);
+    GPUStressTester* tester = bufSet->tester;
+    std::lock_guard<std::mutex> l(tester->readMutex);
+    bufSet->readStatus = status;
+    bufSet->readCompleted = true;
+    tester->pendingCallbacks--;
+    tester->readCond.notify_all();
+}
+
+/* status is negative if last kernel failed (first error of pass is kept) */
+void CL_CALLBACK GPUStressTester::notifyKernelCompleted(cl_event clEvent, cl_int status,
+                void* data)
+{
+    BufferSet* bufSet = reinterpret_cast<BufferSet*>(data);
+    GPUStressTester* tester = bufSet->tester;
+    std::lock_guard<std::mutex> l(tester->readMutex);
+    if (status < 0 && bufSet->kernelStatus >= 0)
+        bufSet->kernelStatus = status;
+    bufSet->kernelCompleted = true;
+    bufSet->completedTime = SteadyClock::now();
+    tester->pendingCallbacks--;
+    tester->readCond.notify_all();
+}
+
+/* status is negative if kernel failed (first error of pass is kept) */
+void CL_CALLBACK GPUStressTester::notifyKernelStatus(cl_event clEvent, cl_int status,
+                void* data)
+{
+    BufferSet* bufSet = reinterpret_cast<BufferSet*>(data);
+    GPUStressTester* tester = bufSet->tester;
+    std::lock_guard<std::mutex> l(tester->readMutex);
+    if (status < 0 && bufSet->kernelStatus >= 0)
+        bufSet->kernelStatus = status;
+    bufSet->pendingKernels--;
+    tester->pendingCallbacks--;
+    tester->readCond.notify_all();
+}
+
+/* register callback which reports status of kernel (no allocation on host side,
+ * time of registration is counted to event overhead) */
+void GPUStressTester::watchKernelEvent(BufferSet& bufSet, cl::Event& clEvent)
+{
+    const std_time_point callbackStartTime = SteadyClock::now();
+    {
+        std::lock_guard<std::mutex> l(readMutex);
+        bufSet.pendingKernels++;
+        pendingCallbacks++;
+    }
+    try
+    { clEvent.setCallback(CL_COMPLETE, notifyKernelStatus, &bufSet); }
+    catch(...)
+    {
+        std::lock_guard<std::mutex> l(readMutex);
+        bufSet.pendingKernels--;
+        pendingCallbacks--;
+        throw;
+    }
+    eventOverheadNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            SteadyClock::now()-callbackStartTime).count();
+}
+
+/* enqueue non-blocking read of results after last kernel,
+ * read callback hands results to verification */
+void GPUStressTester::enqueueReadResults(BufferSet& bufSet)
+{
+    if (verificationMode == 3)
+    {   // results will be read in chunks while checking
+        {
+            std::lock_guard<std::mutex> l(readMutex);
+            bufSet.readCompleted = true;
+        }
+        clCmdQueue1.flush();
+        return;
+    }
+    std::vector<cl::Event> waitEvents(1, (verificationMode == 1) ?
+                bufSet.verifyEvent : bufSet.lastEvent);
+    {
+        std::lock_guard<std::mutex> l(readMutex);
+        bufSet.readCompleted = false;
+        pendingCallbacks++;
+    }
+    try
+    {
+        if (verificationMode == 1)
+            clCmdQueue2.enqueueReadBuffer(bufSet.clMismatchBuffer, CL_FALSE, size_t(0),
+                    sizeof(uint64_t)*bufSet.mismatchInfo.size(), bufSet.mismatchInfo.data(),
+                    &waitEvents, &bufSet.readEvent);
+        else if (verificationMode == 2)
+            clCmdQueue2.enqueueReadBuffer(bufSet.clSignatureBuffer, CL_FALSE, size_t(0),
+                    sizeof(cxuint)*goldenSignatures.size(), bufSet.signatures.data(),
+                    &waitEvents, &bufSet.readEvent);
+        else
+            clCmdQueue2.enqueueReadBuffer(getResultsBuffer(bufSet), CL_FALSE, size_t(0),
+                    bufItemsNum<<2, bufSet.results.get(), &waitEvents, &bufSet.readEvent);
+        bufSet.readEvent.setCallback(CL_COMPLETE, notifyReadCompleted, &bufSet);
+    }
+    catch(...)
+    {
+        std::lock_guard<std::mutex> l(readMutex);
+        pendingCallbacks--;
+        throw;
+    }
+    clCmdQueue1.flush();
+    clCmdQueue2.flush();
+}
+
+void GPUStressTester::waitForResults(BufferSet& bufSet)
+{
+    const std_time_point waitStartTime = SteadyClock::now();
+    {
+        std::unique_lock<std::mutex> l(readMutex);
+        readCond.wait(l, [&bufSet]()
+                { return bufSet.readCompleted && bufSet.kernelCompleted &&
+                        bufSet.pendingKernels == 0; });
+    }
+    eventNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            SteadyClock::now()-waitStartTime).count();
+}
+
+/* wait for all callbacks before leaving test (they refer to buffer sets), never
+ * gives up, because callback of slow (or hung) device can be called later */
+void GPUStressTester::waitForPendingReads()
+{
+    while (true)
+    {
+        cxuint callbacksNum;
+        {
+            std::unique_lock<std::mutex> l(readMutex);
+            if (readCond.wait_for(l, std::chrono::seconds(10), [this]()
+                    { return pendingCallbacks == 0; }))
+                return;
+            callbacksNum = pendingCallbacks;
+        }
+        std::lock_guard<std::mutex> l(stdOutputMutex);
+        *errStream << "#" << id << " Still waiting for " << callbacksNum <<
+                " pending callbacks of device..." << std::endl;
+        handleOutput(id);
+    }
+}
+
+static void checkReadStatus(cl_int readStatus)
+{
+    if (readStatus < 0)
+    {
+        char strBuf[64];
+        snprintf(strBuf, 64, "Failed reading results with code: %d", readStatus);
+        throw MyException(strBuf);
+    }
+}
+
+/* constant cost: status of every kernel of pass is reported by callbacks */
+void GPUStressTester::checkExecutionEvents(BufferSet& bufSet)
+{
+    const std_time_point releaseStartTime = SteadyClock::now();
+    bufSet.lastEvent = cl::Event(); // release event
+    eventOverheadNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            SteadyClock::now()-releaseStartTime).count();
+    if (bufSet.kernelStatus < 0)
+    {
+        char strBuf[64];
+        snprintf(strBuf, 64, "Failed NDRangeKernel with code: %d", bufSet.kernelStatus);
+        throw MyException(strBuf);
+    }
+}
+
+void GPUStressTester::checkResultsOnDevice(BufferSet& bufSet)
+{
+    // mismatch count and indices already read
+    checkEventStatus(bufSet.verifyEvent);
+    checkReadStatus(bufSet.readStatus);
+    addTransferTime(bufSet.readEvent, sizeof(uint64_t)*bufSet.mismatchInfo.size());
+    bufSet.verifyEvent = cl::Event(); // release event
+    bufSet.readEvent = cl::Event();
+    bufSet.isExecuted = false; // now is checked
+    
+    cxuint mismatchesNum; // 32-bit count at begin of mismatch info
+    ::memcpy(&mismatchesNum, bufSet.mismatchInfo.data(), sizeof(cxuint));
+    if (mismatchesNum != 0)
+    {
+        {   /* indices are stored in order of detection, if all are stored
+             * then lowest is first mismatch */
+            const cxuint indicesNum = std::min(mismatchesNum, mismatchIndicesNum);
+            std::sort(bufSet.mismatchInfo.begin()+1,
+                      bufSet.mismatchInfo.begin()+1+indicesNum);
+            std::lock_guard<std::mutex> l(stdOutputMutex);
+            *errStream << "#" << id << " Mismatches: " << mismatchesNum;
+            if (mismatchesNum <= mismatchIndicesNum)
+                *errStream << ", first at index: " << bufSet.mismatchInfo[1];
+            *errStream << ", indices:";
+            for (cxuint i = 0; i < indicesNum; i++)
+                *errStream << " " << bufSet.mismatchInfo[i+1];
+            *errStream << std::endl;
+            handleOutput(id);
+        }
+        readAndReportMismatches(bufSet);
+    }
+    printStatus(bufSet.passNum);
+}
+
+void GPUStressTester::checkSignatures(BufferSet& bufSet)
+{
+    // only signatures of workgroups already read
+    checkReadStatus(bufSet.readStatus);
+    addTransferTime(bufSet.readEvent, sizeof(cxuint)*goldenSignatures.size());
+    bufSet.readEvent = cl::Event(); // release event
+    bufSet.isExecuted = false; // now is checked
+    
+    size_t badGroupsNum = 0;
+    size_t firstBadGroup = 0;
+    for (size_t i = 0; i < goldenSignatures.size(); i++)
+        if (bufSet.signatures[i] != goldenSignatures[i])
+        {
+            if (badGroupsNum == 0)
+                firstBadGroup = i;
+            badGroupsNum++;
+        }
+    if (badGroupsNum != 0)
+    {
+        {
+            std::lock_guard<std::mutex> l(stdOutputMutex);
+            *errStream << "#" << id << " Signatures mismatch in " << badGroupsNum <<
+                    " workgroups, first workgroup: " << firstBadGroup << std::endl;
+            handleOutput(id);
+        }
+        readAndReportMismatches(bufSet);
+    }
+    printStatus(bufSet.passNum);
+}
+
+/* read whole results (only if mismatch has been reported) and report failure */
+void GPUStressTester::readAndReportMismatches(BufferSet& bufSet)
+{
+    if (toCompare == nullptr)
+        toCompare = allocHostArray();
+    if (bufSet.results == nullptr)
+        bufSet.results = allocHostArray();
+    clCmdQueue2.enqueueReadBuffer(clCompareBuffer, CL_TRUE, size_t(0),
+                bufItemsNum<<2, toCompare.get());
+    clCmdQueue2.enqueueReadBuffer(getResultsBuffer(bufSet), CL_TRUE, size_t(0),
+                bufItemsNum<<2, bufSet.results.get());
+    printMismatchReport(toCompare.get(), bufSet.results.get());
+    throwFailedComputations(bufSet.passNum);
+}
+
+/* read results and results to compare in chunks into ring of chunks,
+ * every chunk is compared while next chunks are read */
+void GPUStressTester::checkResultsStreaming(BufferSet& bufSet)
+{
+    bufSet.isExecuted = false; // now is checked
+    const cl::Buffer& resultsBuffer = getResultsBuffer(bufSet);
+    const size_t chunksNum = (bufItemsNum + streamChunkSize-1) / streamChunkSize;
+    auto enqueueChunkReads = [this, &resultsBuffer](size_t chunkIndex)
+    {
+        StreamChunk& chunk = streamChunks[chunkIndex % streamChunks.size()];
+        const size_t offset = chunkIndex*streamChunkSize;
+        const size_t size = std::min(streamChunkSize, bufItemsNum-offset);
+        clCmdQueue2.enqueueReadBuffer(clCompareBuffer, CL_FALSE, offset<<2, size<<2,
+                chunk.expected.get(), nullptr, &chunk.expectedEvent);
+        clCmdQueue2.enqueueReadBuffer(resultsBuffer, CL_FALSE, offset<<2, size<<2,
+                chunk.results.get(), nullptr, &chunk.resultsEvent);
+    };
+    for (size_t i = 0; i < std::min(chunksNum, streamChunks.size()); i++)
+        enqueueChunkReads(i);
+    clCmdQueue2.flush();
+    
+    MismatchStats stats = { 0, { 0, 0 }, { 0, 0 }, { 0, 0 }, 0 };
+    for (size_t i = 0; i < chunksNum; i++)
+    {
+        StreamChunk& chunk = streamChunks[i % streamChunks.size()];
+        const size_t offset = i*streamChunkSize;
+        const size_t size = std::min(streamChunkSize, bufItemsNum-offset);
+        chunk.expectedEvent.wait();
+        chunk.resultsEvent.wait();
+        addTransferTime(chunk.expectedEvent, size<<2);
+        addTransferTime(chunk.resultsEvent, size<<2);
+        chunk.expectedEvent = cl::Event(); // release events
+        chunk.resultsEvent = cl::Event();
+        if (!compareResults(chunk.expected.get(), chunk.results.get(), size))
+            addMismatches(stats, chunk.expected.get(), chunk.results.get(), size, offset);
+        if (i + streamChunks.size() < chunksNum)
+        {   // reuse this chunk
+            enqueueChunkReads(i + streamChunks.size());
+            clCmdQueue2.flush();
+        }
+    }
+    if (stats.mismatchesNum != 0)
+    {
+        printMismatchReport(stats);
+        throwFailedComputations(bufSet.passNum);
+    }
+    printStatus(bufSet.passNum);
+}
+
+void GPUStressTester::checkResults(BufferSet& bufSet)
+{
+    if (verificationMode == 1)
+    {
+        checkResultsOnDevice(bufSet);
+        return;
+    }
+    if (verificationMode == 2)
+    {
+        checkSignatures(bufSet);
+        return;
+    }
+    if (verificationMode == 3)
+    {
+        checkResultsStreaming(bufSet);
+        return;
+    }
+    // results already read
+    checkReadStatus(bufSet.readStatus);
+    addTransferTime(bufSet.readEvent, bufItemsNum<<2);
+    bufSet.readEvent = cl::Event(); // release event
+    bufSet.isExecuted = false; // now is checked
+    if (!compareResults(toCompare.get(), bufSet.results.get(), bufItemsNum))
+    {
+        printMismatchReport(toCompare.get(), bufSet.results.get());
+        throwFailedComputations(bufSet.passNum);
+    }
+    printStatus(bufSet.passNum);
+}
+
 void GPUStressTester::runTest()
 try
 {
-    bool run1Exec = false;
-    bool run2Exec = false;
-    bool result1Checked = false;
-    bool result2Checked = false;
-    std::vector<cl::Event> exec1Events(passItersNum);
-    std::vector<cl::Event> exec2Events(passItersNum);
-    clKernel.setArg(0, cl_uint(workSize));
-    if (usePolyWalker)
-    {
-        clKernel.setArg(3, examplePoly[0]);
-        clKernel.setArg(4, examplePoly[1]);
-        clKernel.setArg(5, examplePoly[2]);
-        clKernel.setArg(6, examplePoly[3]);
-        clKernel.setArg(7, examplePoly[4]);
-    }
-    
-    cxuint pass1Num = 1;
-    cxuint pass2Num = 2;
+    cxuint passNum = 1;
     try
     {
     startTime = RealtimeClock::now();
     lastTime = SteadyClock::now();
+    lastPassEndTime = std_time_point();
     
-    while (true)
+    /* buffer sets are used as ring: while results of the oldest buffer set are
+     * checked, kernels for the other buffer sets are still queued */
+    for (cxuint curSet = 0; ; curSet = (curSet+1) % pipelineDepth)
     {
-        if (stopAllStressTestersIfFail.load())
-        {
-            std::lock_guard<std::mutex> l(stdOutputMutex);
-            *outStream << "#" << id << " Exiting, because some device failed." << std::endl;
-            handleOutput(id);
-            break;
-        }
-        if (stopAllStressTestersByUser.load())
-        {
-            std::lock_guard<std::mutex> l(stdOutputMutex);
-            *outStream << "#" << id << " Exiting, because user stopped test." << std::endl;
-            handleOutput(id);
-            break;
-        }
-        
-        clCmdQueue2.enqueueWriteBuffer(clBuffer1, CL_TRUE, size_t(0), bufItemsNum<<2,
-                initialValues);
-        /* run execution 1 */
-        if (!useInputAndOutput)
-        {
-            clKernel.setArg(1, clBuffer1());
-            clKernel.setArg(2, clBuffer1());
-        }
-        
-        cxuint stepsAfterWait = 0;
-        bool allIsExecuted = true;
-        for (cxuint i = 0; i < passItersNum; i++)
-        {
-            if (stopAllStressTestersIfFail.load() || stopAllStressTestersByUser.load())
-            {
-                allIsExecuted = false;
-                break;
-            }
-            if (useInputAndOutput)
-            {
-                if ((i&1) == 0)
-                {
-                    clKernel.setArg(1, clBuffer1());
-                    clKernel.setArg(2, clBuffer2());
-                }
-                else
-                {
-                    clKernel.setArg(1, clBuffer2());
-                    clKernel.setArg(2, clBuffer1());
-                }
-            }
-            clCmdQueue1.enqueueNDRangeKernel(clKernel, cl::NDRange(0),
-                    cl::NDRange(workSize), cl::NDRange(groupSize), nullptr, &exec1Events[i]);
-            stepsAfterWait++;
-            if (stepsAfterWait >= stepsPerWait && i+((stepsPerWait+1)>>1) < passItersNum)
-            {   /* wait for ndrange kernel and ensure fluent working */
-                stepsAfterWait = 0;
-                try
-                { exec1Events[i-1].wait(); }
-                catch(const cl::Error& err)
-                {
-                    if (err.err() != CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST)
-                        throw; // if other error
-                    int eventStatus;
-                    exec1Events[i-1].getInfo(CL_EVENT_COMMAND_EXECUTION_STATUS, &eventStatus);
-                    if (eventStatus < 0)
-                    {
-                        char strBuf[64];
-                        snprintf(strBuf, 64, "Failed NDRangeKernel with code: %d", eventStatus);
-                        throw MyException(strBuf);
-                    }
-                }
-            }
-        }
-        if (allIsExecuted)
-        {
-            run1Exec = true;
-            result1Checked = false; // not yet checked
-        }
-        if (stopAllStressTestersIfFail.load())
-        {
-            std::lock_guard<std::mutex> l(stdOutputMutex);
-            *outStream << "#" << id << " Exiting, because some device failed." << std::endl;
-            handleOutput(id);
-            break;
-        }
-        if (stopAllStressTestersByUser.load())
-        {
-            std::lock_guard<std::mutex> l(stdOutputMutex);
-            *outStream << "#" << id << " Exiting, because user stopped test." << std::endl;
-            handleOutput(id);
-            break;
-        }
-        
-        if (run2Exec)
-        {   /* after exec2 */
-            try
-            { exec2Events[passItersNum-1].wait(); }
-            catch(const cl::Error& err)
-            {
-                if (err.err() != CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST)
-                    throw; // if other error
-            }
-            run2Exec = false;
-            for (cxuint i = 0; i < passItersNum; i++)
-            {   // check kernel event status
-                int eventStatus;
-                exec2Events[i].getInfo(CL_EVENT_COMMAND_EXECUTION_STATUS, &eventStatus);
-                if (eventStatus < 0)
-                {
-                    char strBuf[64];
-                    snprintf(strBuf, 64, "Failed NDRangeKernel with code: %d", eventStatus);
-                    throw MyException(strBuf);
-                }
-                exec2Events[i] = cl::Event(); // release event
-            }
-            // get results
-            if (!useInputAndOutput || (passItersNum&1) == 0)
-                clCmdQueue2.enqueueReadBuffer(clBuffer3, CL_TRUE, size_t(0), bufItemsNum<<2,
-                            results);
-            else //
-                clCmdQueue2.enqueueReadBuffer(clBuffer4, CL_TRUE, size_t(0), bufItemsNum<<2,
-                            results);
-            if (::memcmp(toCompare, results, bufItemsNum<<2))
-                throwFailedComputations(pass2Num);
-            printStatus(pass2Num);
-            pass2Num += 2;
-            result2Checked = true; // now is checked
-        }
-        
-        if (stopAllStressTestersIfFail.load())
-        {
-            std::lock_guard<std::mutex> l(stdOutputMutex);
-            *outStream << "#" << id << " Exiting, because some device failed." << std::endl;
-            handleOutput(id);
-            break;
-        }
-        if (stopAllStressTestersByUser.load())
-        {
-            std::lock_guard<std::mutex> l(stdOutputMutex);
-            *outStream << "#" << id << " Exiting, because user stopped test." << std::endl;
-            handleOutput(id);
+        if (checkStopping())
             break;
-        }
-        
-        clCmdQueue2.enqueueWriteBuffer(clBuffer3, CL_TRUE, size_t(0), bufItemsNum<<2,
-                initialValues);
-        /* run execution 2 */
-        if (!useInputAndOutput)
-        {
-            clKernel.setArg(1, clBuffer3());
-            clKernel.setArg(2, clBuffer3());
-        }
         
-        stepsAfterWait = 0;
-        allIsExecuted = true;
-        for (cxuint i = 0; i < passItersNum; i++)
-        {
-            if (stopAllStressTestersIfFail.load() || stopAllStressTestersByUser.load())
-            {
-                allIsExecuted = false;
-                break;
-            }
-            if (useInputAndOutput)
-            {
-                if ((i&1) == 0)
-                {
-                    clKernel.setArg(1, clBuffer3());
-                    clKernel.setArg(2, clBuffer4());
-                }
-                else
-                {
-                    clKernel.setArg(1, clBuffer4());
-                    clKernel.setArg(2, clBuffer3());
-                }
-            }
-            clCmdQueue1.enqueueNDRangeKernel(clKernel, cl::NDRange(0),
-                    cl::NDRange(workSize), cl::NDRange(groupSize), nullptr, &exec2Events[i]);
-            stepsAfterWait++;
-            if (stepsAfterWait >= stepsPerWait && i+((stepsPerWait+1)>>1) < passItersNum)
-            {   /* wait for ndrange kernel and ensure fluent working */
-                stepsAfterWait = 0;
-                try
-                { exec2Events[i-1].wait(); }
-                catch(const cl::Error& err)
-                {
-                    if (err.err() != CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST)
-                        throw; // if other error
-                    int eventStatus;
-                    exec2Events[i-1].getInfo(CL_EVENT_COMMAND_EXECUTION_STATUS, &eventStatus);
-                    if (eventStatus < 0)
-                    {
-                        char strBuf[64];
-                        snprintf(strBuf, 64, "Failed NDRangeKernel with code: %d", eventStatus);
-                        throw MyException(strBuf);
-                    }
-                }
-            }
-        }
-        if (allIsExecuted)
-        {
-            run2Exec = true;
-            result2Checked = false; // not yet checked
-        }
-        if (stopAllStressTestersIfFail.load())
+        BufferSet& bufSet = bufferSets[curSet];
+        if (enqueueExecution(bufSet))
         {
-            std::lock_guard<std::mutex> l(stdOutputMutex);
-            *outStream << "#" << id << " Exiting, because some device failed." << std::endl;
-            handleOutput(id);
-            break;
+            bufSet.passNum = passNum++;
+            bufSet.isExecuted = true; // not yet checked
         }
-        if (stopAllStressTestersByUser.load())
-        {
-            std::lock_guard<std::mutex> l(stdOutputMutex);
-            *outStream << "#" << id << " Exiting, because user stopped test." << std::endl;
-            handleOutput(id);
+        if (checkStopping())
             break;
-        }
         
-        if (run1Exec)
-        {   /* after exec1 */
-            try
-            { exec1Events[passItersNum-1].wait(); }
-            catch(const cl::Error& err)
-            {
-                if (err.err() != CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST)
-                    throw; // if other error
-            }
-            run1Exec = false;
-            for (cxuint i = 0; i < passItersNum; i++)
-            {   // check kernel event status
-                int eventStatus;
-                exec1Events[i].getInfo(CL_EVENT_COMMAND_EXECUTION_STATUS, &eventStatus);
-                if (eventStatus < 0)
-                {
-                    char strBuf[64];
-                    snprintf(strBuf, 64, "Failed NDRangeKernel with code: %d", eventStatus);
-                    throw MyException(strBuf);
-                }
-                exec1Events[i] = cl::Event(); // release event
-            }
-            // get results
-            if (!useInputAndOutput || (passItersNum&1) == 0)
-                clCmdQueue2.enqueueReadBuffer(clBuffer1, CL_TRUE, size_t(0), bufItemsNum<<2,
-                            results);
-            else //
-                clCmdQueue2.enqueueReadBuffer(clBuffer2, CL_TRUE, size_t(0), bufItemsNum<<2,
-                            results);
-            if (::memcmp(toCompare, results, bufItemsNum<<2))
-                throwFailedComputations(pass1Num);
-            printStatus(pass1Num);
-            pass1Num += 2;
-            result1Checked = true; // now is checked
+        BufferSet& oldestSet = bufferSets[(curSet+1) % pipelineDepth];
+        if (oldestSet.isExecuted)
+        {   /* after execution and reading results of oldest buffer set */
+            waitForResults(oldestSet);
+            updateStepsPerWait(oldestSet);
+            checkExecutionEvents(oldestSet);
+            checkResults(oldestSet);
         }
     }
     }
@@ -1313,6 +3265,7 @@ try
             *errStream << "Failed on CommandQueue2 finish" << std::endl;
             handleOutput(id);
         }
+        waitForPendingReads();
         throw;
     }
     
@@ -1337,64 +3290,26 @@ try
         queuesFinished = false;
     }
     
-    if (!queuesFinished)
-        return; // if queues failed do not check (only returns)
+    waitForPendingReads();
     
-    /* after break check kernel events and results */
+    /* after break check kernel events and results of all queued passes (in pass
+     * order), also if queues failed, because all callbacks have been completed */
+    std::vector<BufferSet*> executedSets;
+    for (BufferSet& bufSet: bufferSets)
+        if (bufSet.isExecuted)
+            executedSets.push_back(&bufSet);
+    std::sort(executedSets.begin(), executedSets.end(),
+              [](const BufferSet* a, const BufferSet* b)
+              { return a->passNum < b->passNum; });
+    for (BufferSet* bufSet: executedSets)
     {
-        cxuint i;
-        for (i = 0; i < passItersNum; i++)
-        {   // check kernel event status
-            int eventStatus;
-            if (exec1Events[i]() == nullptr)
-                break; // no other events
-            exec1Events[i].getInfo(CL_EVENT_COMMAND_EXECUTION_STATUS, &eventStatus);
-            if (eventStatus < 0)
-            {
-                char strBuf[64];
-                snprintf(strBuf, 64, "Failed NDRangeKernel with code: %d", eventStatus);
-                throw MyException(strBuf);
-            }
-        }
-        if (i == passItersNum && !result1Checked)
-        {   // get results
-            if (!useInputAndOutput || (passItersNum&1) == 0)
-                clCmdQueue2.enqueueReadBuffer(clBuffer1, CL_TRUE, size_t(0), bufItemsNum<<2,
-                            results);
-            else //
-                clCmdQueue2.enqueueReadBuffer(clBuffer2, CL_TRUE, size_t(0), bufItemsNum<<2,
-                            results);
-            if (::memcmp(toCompare, results, bufItemsNum<<2))
-                throwFailedComputations(pass1Num);
-            printStatus(pass1Num);
-        }
-        
-        for (i = 0; i < passItersNum; i++)
-        {   // check kernel event status
-            int eventStatus;
-            if (exec2Events[i]() == nullptr)
-                break; // no other events
-            exec2Events[i].getInfo(CL_EVENT_COMMAND_EXECUTION_STATUS, &eventStatus);
-            if (eventStatus < 0)
-            {
-                char strBuf[64];
-                snprintf(strBuf, 64, "Failed NDRangeKernel with code: %d", eventStatus);
-                throw MyException(strBuf);
-            }
-        }
-        if (i == passItersNum && !result2Checked)
-        {   // get results
-            if (!useInputAndOutput || (passItersNum&1) == 0)
-                clCmdQueue2.enqueueReadBuffer(clBuffer3, CL_TRUE, size_t(0), bufItemsNum<<2,
-                            results);
-            else //
-                clCmdQueue2.enqueueReadBuffer(clBuffer4, CL_TRUE, size_t(0), bufItemsNum<<2,
-                            results);
-            if (::memcmp(toCompare, results, bufItemsNum<<2))
-                throwFailedComputations(pass2Num);
-            printStatus(pass2Num);
-        }
+        waitForResults(*bufSet);
+        updateStepsPerWait(*bufSet);
+        checkExecutionEvents(*bufSet);
+        checkResults(*bufSet);
     }
+    if (!queuesFinished)
+        throw MyException("Can't finish command queues!");
 }
 catch(const cl::Error& error)
 {
@@ -1458,3 +3373,427 @@ catch(...)
         handleOutput(id);
     } // fatal exception!!!
 }
+
+/*
+ * autotuner
+ */
+
+/* explores groupSize, workFactor, blocksNum and kitersNum jointly (coordinate descent
+ * started from given configuration) within time budget and memory limit */
+class GPUAutotuner
+{
+private:
+    struct Params
+    {
+        size_t groupSize;
+        cxuint workFactor;
+        cxuint blocksNum;
+        cxuint kitersNum;
+        
+        bool operator<(const Params& p) const
+        {
+            if (groupSize != p.groupSize)
+                return groupSize < p.groupSize;
+            if (workFactor != p.workFactor)
+                return workFactor < p.workFactor;
+            if (blocksNum != p.blocksNum)
+                return blocksNum < p.blocksNum;
+            return kitersNum < p.kitersNum;
+        }
+    };
+    
+    cxuint id;
+    cl::Device clDevice;
+    cl::Context clContext;
+    cl::CommandQueue profCmdQueue;
+    std::string platformName;
+    std::string deviceName;
+    GPUStressConfig config;
+    BuiltinKernel builtinKernel;
+    cl_uint maxComputeUnits;
+    size_t maxGroupSize;
+    cl_ulong maxAllocSize;
+    cl_ulong memoryLimit; // zero if no limit
+    SteadyClock::time_point deadline;
+    
+    std::map<Params, double> scores;
+    Params best;
+    double bestScore;
+    
+    // buffers for current groupSize, workFactor and blocksNum
+    Params buffersParams;
+    size_t workSize;
+    size_t bufItemsNum;
+    cl::Buffer clInitBuffer, clBuffer1, clBuffer2;
+    
+    bool isTimeExceeded() const
+    { return SteadyClock::now() >= deadline || stopAllStressTestersByUser.load(); }
+    bool prepareBuffers(const Params& params);
+    double measure(const Params& params);
+    void evaluate(const Params& params);
+public:
+    GPUAutotuner(cxuint id, cl::Device& clDevice, const GPUStressConfig& config);
+    
+    GPUStressConfig run();
+};
+
+GPUAutotuner::GPUAutotuner(cxuint _id, cl::Device& _clDevice,
+            const GPUStressConfig& _config) : id(_id), clDevice(_clDevice), config(_config)
+{
+    cl::Platform clPlatform;
+    clDevice.getInfo(CL_DEVICE_PLATFORM, &clPlatform);
+    clPlatform.getInfo(CL_PLATFORM_NAME, &platformName);
+    platformName = trimSpaces(platformName);
+    clDevice.getInfo(CL_DEVICE_NAME, &deviceName);
+    deviceName = trimSpaces(deviceName);
+    clDevice.getInfo(CL_DEVICE_MAX_COMPUTE_UNITS, &maxComputeUnits);
+    clDevice.getInfo(CL_DEVICE_MAX_WORK_GROUP_SIZE, &maxGroupSize);
+    clDevice.getInfo(CL_DEVICE_MAX_MEM_ALLOC_SIZE, &maxAllocSize);
+    memoryLimit = cl_ulong(autotuneMemory)<<20;
+    builtinKernel = getBuiltinKernel(config.builtinKernel);
+    checkBuiltinKernelSupport(clDevice, builtinKernel);
+    
+    cl_context_properties clContextProps[3];
+    clContextProps[0] = CL_CONTEXT_PLATFORM;
+    clContextProps[1] = reinterpret_cast<cl_context_properties>(clPlatform());
+    clContextProps[2] = 0;
+    clContext = cl::Context(clDevice, clContextProps);
+    profCmdQueue = cl::CommandQueue(clContext, clDevice, CL_QUEUE_PROFILING_ENABLE);
+    
+    bestScore = 0.0;
+    best.groupSize = 0;
+    best.workFactor = best.blocksNum = best.kitersNum = 0;
+    buffersParams = best;
+    workSize = bufItemsNum = 0;
+}
+
+/* allocate buffers and fill initial values, returns false if memory is too big */
+bool GPUAutotuner::prepareBuffers(const Params& params)
+{
+    if (buffersParams.groupSize == params.groupSize &&
+        buffersParams.workFactor == params.workFactor &&
+        buffersParams.blocksNum == params.blocksNum)
+        return true; // already prepared
+    clInitBuffer = clBuffer1 = clBuffer2 = cl::Buffer();
+    buffersParams = params;
+    buffersParams.groupSize = 0; // not prepared
+    
+    workSize = size_t(maxComputeUnits)*params.groupSize*params.workFactor;
+    bufItemsNum = (workSize<<4)*params.blocksNum;
+    const cl_ulong bufSize = cl_ulong(bufItemsNum)<<2;
+    /* device memory of test (as in applyMemoryTarget): pipelineDepth buffer sets,
+     * initial values and (if results are compared on device) results to compare */
+    const cl_ulong testMemSize = bufSize*(cl_ulong(config.pipelineDepth)*
+            (config.inputAndOutput ? 2 : 1) +
+            (getTestVerificationMode(config.builtinKernel) != 0 ? 2 : 1));
+    if (bufSize > maxAllocSize || (memoryLimit != 0 && testMemSize > memoryLimit))
+        return false;
+    
+    std::vector<float> initialValues(bufItemsNum);
+    generateInitialValues(initialValues.data(), bufItemsNum, builtinKernel.initValuesType,
+            getRandomSeed());
+    clInitBuffer = cl::Buffer(clContext, CL_MEM_READ_ONLY, bufItemsNum<<2);
+    clBuffer1 = cl::Buffer(clContext, CL_MEM_READ_WRITE, bufItemsNum<<2);
+    if (config.inputAndOutput)
+        clBuffer2 = cl::Buffer(clContext, CL_MEM_READ_WRITE, bufItemsNum<<2);
+    profCmdQueue.enqueueWriteBuffer(clInitBuffer, CL_TRUE, size_t(0), bufItemsNum<<2,
+            initialValues.data());
+    if (config.inputAndOutput)
+    {
+        profCmdQueue.enqueueCopyBuffer(clInitBuffer, clBuffer1, size_t(0), size_t(0),
+                bufItemsNum<<2);
+        profCmdQueue.finish();
+    }
+    buffersParams.groupSize = params.groupSize;
+    return true;
+}
+
+/* measure kernel for parameters (if not yet measured) and update the best */
+void GPUAutotuner::evaluate(const Params& params)
+{
+    if (params.kitersNum < 1 || params.kitersNum > 40 || params.blocksNum < 1 ||
+        params.blocksNum > 16 || params.workFactor == 0 || params.groupSize == 0 ||
+        scores.find(params) != scores.end() || isTimeExceeded())
+        return;
+    if (builtinKernel.flopsPerIter == 0 && params.kitersNum != 1)
+        return; // memory tests have no kernel iterations
+    double& score = scores[params];
+    score = 0.0; // if configuration can't be used
+    try
+    { score = measure(params); }
+    catch(const cl::Error& error)
+    {   /* configuration is infeasible (for example buffers can't be allocated),
+         * skip it and continue autotuning */
+        clInitBuffer = clBuffer1 = clBuffer2 = cl::Buffer();
+        buffersParams.groupSize = 0; // not prepared
+        std::lock_guard<std::mutex> l(stdOutputMutex);
+        *outStream << "#" << id << " groupSize=" << params.groupSize <<
+                ", workFactor=" << params.workFactor << ", blocksNum=" << params.blocksNum <<
+                ", kitersNum=" << params.kitersNum << ": skipped, OpenCL error: " <<
+                error.what() << ", Code: " << error.err() << std::endl;
+        handleOutput(id);
+        return;
+    }
+    if (score > bestScore)
+    {
+        bestScore = score;
+        best = params;
+    }
+}
+
+/* measure configuration and returns its score (zero if it can't be used) */
+double GPUAutotuner::measure(const Params& params)
+{
+    if (!prepareBuffers(params))
+        return 0.0;
+    
+    cl::Program::Sources clSources;
+    clSources.push_back(std::make_pair(clKernelCommonSource,
+                ::strlen(clKernelCommonSource)));
+    clSources.push_back(std::make_pair(builtinKernel.source,
+                ::strlen(builtinKernel.source)));
+    cl::Program program(clContext, clSources);
+    char buildOptions[192];
+    const int optsLen = snprintf(buildOptions, 192, "-DGROUPSIZE=" SIZE_T_SPEC
+            "U -DKITERSNUM=%uU -DBLOCKSNUM=%uU",
+            params.groupSize, params.kitersNum, params.blocksNum);
+    if (builtinKernel.flopsPerIter == 0)
+    {   // memory tests: number of items and multiplier of item index
+        const cl_ulong itemsNum = cl_ulong(workSize)*params.blocksNum;
+        snprintf(buildOptions+optsLen, 192-optsLen,
+                " -DITEMSNUM=%lluUL -DITEMMUL=%lluUL", (unsigned long long)itemsNum,
+                (unsigned long long)memTestMultiplier(itemsNum));
+    }
+    try
+    { program.build(buildOptions); }
+    catch(const cl::Error& error)
+    { return 0.0; } // skip this configuration
+    cl::Kernel kernel(program, "gpuStress");
+    size_t kernelGroupSize;
+    kernel.getWorkGroupInfo(clDevice, CL_KERNEL_WORK_GROUP_SIZE, &kernelGroupSize);
+    if (kernelGroupSize < params.groupSize)
+        return 0.0;
+    
+    kernel.setArg(0, cl_uint(workSize));
+    kernel.setArg(1, clBuffer1());
+    kernel.setArg(2, config.inputAndOutput ? clBuffer2() : clBuffer1());
+    if (builtinKernel.usePolyWalker)
+        for (cxuint i = 0; i < 5; i++)
+            kernel.setArg(3+i, examplePoly[i]);
+    TimingStats stats;
+    const cl_ulong kernelTime = profileKernelRuns(profCmdQueue, kernel, workSize,
+            params.groupSize, config.inputAndOutput ? nullptr : &clInitBuffer,
+            clBuffer1, bufItemsNum<<2, fineTiming, stats);
+    if (kernelTime == 0)
+        return 0.0;
+    
+    const double bandwidth = 2.0*4.0*double(bufItemsNum) / double(kernelTime);
+    const double perf = double(builtinKernel.flopsPerIter) * double(params.kitersNum) *
+            double(bufItemsNum) / double(kernelTime);
+    {
+        std::lock_guard<std::mutex> l(stdOutputMutex);
+        *outStream << "#" << id << " groupSize=" << params.groupSize <<
+                ", workFactor=" << params.workFactor << ", blocksNum=" << params.blocksNum <<
+                ", kitersNum=" << params.kitersNum << ": " << bandwidth << " GB/s";
+        if (builtinKernel.flopsPerIter != 0)
+            *outStream << ", " << perf << " " <<
+                    GPUStressTester::getPerfUnit(builtinKernel.useFP64);
+        *outStream << std::endl;
+        handleOutput(id);
+    }
+    if (builtinKernel.flopsPerIter == 0) // memory tests: only bandwidth
+        return bandwidth;
+    else if (autotuneObjective == 1)
+        return perf;
+    else if (autotuneObjective == 2)
+        return bandwidth;
+    return bandwidth*perf;
+}
+
+GPUStressConfig GPUAutotuner::run()
+{
+    {
+        std::lock_guard<std::mutex> l(stdOutputMutex);
+        *outStream << "Autotuning for\n  " <<
+                "#" << id << " " << platformName << ":" << deviceName << "..." << std::endl;
+        handleOutput(id);
+    }
+    deadline = SteadyClock::now() + std::chrono::seconds(autotuneTime);
+    
+    Params start;
+    start.groupSize = (config.groupSize != 0) ? config.groupSize : maxGroupSize;
+    start.workFactor = config.workFactor;
+    start.blocksNum = config.blocksNum;
+    start.kitersNum = 1;
+    // kitersNum for starting parameters from coarse grid
+    const cxuint coarseKiters[9] = { 1, 6, 11, 16, 21, 26, 31, 36, 40 };
+    for (cxuint kitersNum: coarseKiters)
+    {
+        start.kitersNum = kitersNum;
+        evaluate(start);
+    }
+    
+    std::vector<size_t> groupSizes;
+    for (size_t gs = maxGroupSize; gs != 0 && groupSizes.size() < 4; gs >>= 1)
+        groupSizes.push_back(gs);
+    if (config.groupSize != 0 && config.groupSize < maxGroupSize)
+        groupSizes.push_back(config.groupSize);
+    std::vector<cxuint> workFactors;
+    for (cxuint shift = 0; shift < 5; shift++)
+        if ((config.workFactor<<2)>>shift != 0)
+            workFactors.push_back((config.workFactor<<2)>>shift);
+    const cxuint blocksNums[5] = { 1, 2, 4, 8, 16 };
+    
+    /* coordinate descent: change single parameter at once until no improvement */
+    while (bestScore != 0.0 && !isTimeExceeded())
+    {
+        const Params prevBest = best;
+        Params params = best;
+        for (size_t groupSize: groupSizes)
+        {
+            params.groupSize = groupSize;
+            evaluate(params);
+        }
+        params = best;
+        for (cxuint workFactor: workFactors)
+        {
+            params.workFactor = workFactor;
+            evaluate(params);
+        }
+        params = best;
+        for (cxuint blocksNum: blocksNums)
+        {
+            params.blocksNum = blocksNum;
+            evaluate(params);
+        }
+        params = best;
+        for (cxint delta = -4; delta <= 4; delta++)
+        {
+            params.kitersNum = best.kitersNum+delta;
+            evaluate(params);
+        }
+        if (!(prevBest < best) && !(best < prevBest))
+            break; // no improvement
+    }
+    
+    if (bestScore == 0.0)
+        throw MyException("Autotuning failed: no usable configuration found");
+    
+    GPUStressConfig outConfig = config;
+    outConfig.groupSize = best.groupSize;
+    outConfig.workFactor = best.workFactor;
+    outConfig.blocksNum = best.blocksNum;
+    outConfig.kitersNum = best.kitersNum;
+    {
+        std::lock_guard<std::mutex> l(stdOutputMutex);
+        *outStream << "Autotuned configuration for\n  " <<
+                "#" << id << " " << platformName << ":" << deviceName << "\n"
+                "  groupSize=" << best.groupSize << ", workFactor=" << best.workFactor <<
+                ", blocksNum=" << best.blocksNum << ", kitersNum=" << best.kitersNum <<
+                ", checked configurations: " << scores.size() << std::endl;
+        handleOutput(id);
+    }
+    return outConfig;
+}
+
+GPUStressConfig autotuneGPUStressConfig(cxuint id, cl::Device& clDevice,
+            const GPUStressConfig& config)
+{
+    if (autotuneTime <= 0)
+        throw MyException("Autotuning time must be positive!");
+    if (autotuneMemory < 0)
+        throw MyException("Autotuning memory limit must be non-negative!");
+    if (autotuneObjective < 0 || autotuneObjective > 2)
+        throw MyException("Unsupported autotuning objective!");
+    GPUAutotuner autotuner(id, clDevice, config);
+    return autotuner.run();
+}
+
+/* options for CLI to replay configurations */
+std::string getGPUStressConfigsOptions(const std::vector<GPUStressConfig>& configs)
+{
+    std::string testTypes, groupSizes, workFactors, blocksNums, kitersNums, inAndOuts;
+    std::string passItersNums, pipelineDepths;
+    for (size_t i = 0; i < configs.size(); i++)
+    {
+        const char* sep = (i != 0) ? "," : "";
+        testTypes += sep + std::to_string(configs[i].builtinKernel);
+        groupSizes += sep + std::to_string(configs[i].groupSize);
+        workFactors += sep + std::to_string(configs[i].workFactor);
+        blocksNums += sep + std::to_string(configs[i].blocksNum);
+        kitersNums += sep + std::to_string(configs[i].kitersNum);
+        passItersNums += sep + std::to_string(configs[i].passItersNum);
+        pipelineDepths += sep + std::to_string(configs[i].pipelineDepth);
+        inAndOuts += configs[i].inputAndOutput ? 'Y' : 'N';
+    }
+    return "-T " + testTypes + " -I " + inAndOuts + " -g " + groupSizes +
+            " -W " + workFactors + " -B " + blocksNums + " -j " + kitersNums +
+            " -S " + passItersNums + " -P " + pipelineDepths;
+}
+
+/* construct testers for all devices concurrently (every device in own thread) */
+bool createGPUStressTesters(std::vector<cl::Device>& clDevices,
+            const std::vector<GPUStressConfig>& configs,
+            std::vector<GPUStressTester*>& testers)
+{
+    testers.assign(clDevices.size(), nullptr);
+    std::vector<char> deviceFailed(clDevices.size(), 0);
+    std::vector<std::thread> preparingThreads;
+    size_t supportedNum = 0;
+    for (size_t i = 0; i < clDevices.size(); i++)
+    {   /* device which can't run test is skipped (not failed), other devices
+         * are tested */
+        if (!isGPUStressConfigSupported(clDevices[i], configs[i]))
+        {
+            printUnsupportedDevice(i, clDevices[i]);
+            continue;
+        }
+        supportedNum++;
+        preparingThreads.push_back(std::thread([i, &clDevices, &configs, &testers,
+                    &deviceFailed]()
+        {
+            try
+            {
+                GPUStressTester* stressTester = new GPUStressTester(i, clDevices[i],
+                            configs[i]);
+                if (!stressTester->isInitialized())
+                    delete stressTester; // stopped by user or because other device failed
+                else
+                    testers[i] = stressTester;
+                return;
+            }
+            catch(const cl::Error& error)
+            {
+                std::lock_guard<std::mutex> l(stdOutputMutex);
+                *errStream << "#" << i << " OpenCL error happened: " << error.what() <<
+                        ", Code: " << error.err() << std::endl;
+                handleOutput(i);
+            }
+            catch(const std::exception& ex)
+            {
+                std::lock_guard<std::mutex> l(stdOutputMutex);
+                *errStream << "#" << i << " Exception happened: " << ex.what() << std::endl;
+                handleOutput(i);
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> l(stdOutputMutex);
+                *errStream << "#" << i << " Unknown exception happened" << std::endl;
+                handleOutput(i);
+            }
+            deviceFailed[i] = 1;
+            if (!exitIfAllFails) // don't wait for preparing other devices
+                stopAllStressTestersIfFail.store(true);
+        }));
+    }
+    for (std::thread& thread: preparingThreads)
+        thread.join();
+    if (supportedNum == 0)
+    {
+        std::lock_guard<std::mutex> l(stdOutputMutex);
+        *errStream << "No device can run choosen tests!" << std::endl;
+        handleOutput(UINT_MAX);
+        return false;
+    }
+    return std::find(deviceFailed.begin(), deviceFailed.end(), 1) == deviceFailed.end();
+}
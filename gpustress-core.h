@@ -25,8 +25,11 @@
 #include <exception>
 #include <numeric>
 #include <string>
+#include <memory>
 #include <vector>
+#include <map>
 #include <mutex>
+#include <condition_variable>
 #include <random>
 #include <chrono>
 #include <atomic>
@@ -80,10 +83,49 @@ struct GPUStressConfig
     cxuint kitersNum;
     cxuint builtinKernel;
     bool inputAndOutput;
+    cxuint pipelineDepth;
 };
 
 typedef void (*OutputHandler)(void* data, cxuint id);
 
+/* sampling plan of time measurements: warm-up runs are not counted, sampling stops
+ * after minSamples if relative half-width of confidence interval of median is not
+ * greater than maxRelativeCI, or after maxSamples */
+struct TimingConfig
+{
+    cxuint warmupRuns;
+    cxuint minSamples;
+    cxuint maxSamples;
+    double maxRelativeCI;
+};
+
+/* robust statistics of measured times (median, percentiles, MAD) */
+class TimingStats
+{
+private:
+    std::vector<uint64_t> samples; // kept sorted
+public:
+    void clear()
+    { samples.clear(); }
+    void addSample(cl_ulong sample);
+    
+    size_t getSamplesNum() const
+    { return samples.size(); }
+    cl_ulong getMin() const
+    { return samples.empty() ? 0 : samples.front(); }
+    /* percentile (0-100) with linear interpolation between samples */
+    double getPercentile(double percent) const;
+    double getMedian() const
+    { return getPercentile(50.0); }
+    /* median absolute deviation */
+    double getMAD() const;
+    /* half-width of 95% confidence interval of median (normal approximation,
+     * standard deviation estimated from MAD) */
+    double getMedianCI() const;
+    /* returns true if sampling should be finished for given plan */
+    bool isEnough(const TimingConfig& config) const;
+};
+
 extern int useCPUs;
 extern int useGPUs;
 extern int useAccelerators;
@@ -93,6 +135,27 @@ extern int useIntelPlatform;
 extern bool useAllPlatforms;
 
 extern int exitIfAllFails;
+/* 0 - compare whole results on host, 1 - compare results on device,
+ * 2 - compare signatures, 3 - compare results on host in chunks (streaming) */
+extern int verificationMode;
+/* verification mode used for test type: memory tests (4-7) are always verified
+ * on device (host comparing is replaced by comparing on device) */
+extern int getTestVerificationMode(cxuint builtinKernel);
+extern int maxStopLatency; // in milliseconds
+extern int enqueueBenchmark;
+extern const char* programCacheDir; // if null, programs are not cached
+extern const char* calibrationDBFile; // if null, calibrations are not stored
+extern int calibrationTolerance; // in percents
+extern int exhaustiveCalibration;
+extern int specializedCalibration; // compile program for every checked kitersNum
+extern const char* randomSeedString; // if null, seed is random
+extern int hostInitialValues; // generate initial values on host instead of device
+extern const char* memoryTargetString; // megabytes or percent of device memory
+extern const char* memoryPoolString; // megabytes or percent of device memory
+extern int autotuneTime; // time budget for single device in seconds
+extern int autotuneMemory; // memory limit in megabytes (zero - no limit)
+extern int autotuneObjective; // 0 - bandwidth*perf, 1 - perf, 2 - bandwidth
+extern int usePinnedMemory;
 
 extern std::mutex stdOutputMutex;
 extern std::ostream* outStream;
@@ -109,15 +172,29 @@ extern std::vector<cxuint> parseCmdUIntList(const char* str, const char* name);
 
 extern std::vector<bool> parseCmdBoolList(const char* str, const char* name);
 
+/* parse memory target: megabytes or percent (with '%') of device global memory */
+extern cl_ulong parseMemoryTarget(const char* str, cl_ulong globalMemSize);
+
 extern std::vector<cl::Device> getChoosenCLDevices();
 
+/* seed of initial values (from option or random), this same for all devices */
+extern cl_ulong getRandomSeed();
+
 extern std::vector<cl::Device> getChoosenCLDevicesFromList(const char* str);
 
 extern std::vector<GPUStressConfig> collectGPUStressConfigs(cxuint devicesNum,
         const std::vector<cxuint>& passItersNumVec, const std::vector<cxuint>& groupSizeVec,
         const std::vector<cxuint>& workFactorVec,
         const std::vector<cxuint>& blocksNumVec, const std::vector<cxuint>& kitersNumVec,
-        const std::vector<cxuint>& builtinKernelVec, const std::vector<bool>& inAndOutVec);
+        const std::vector<cxuint>& builtinKernelVec, const std::vector<bool>& inAndOutVec,
+        const std::vector<cxuint>& pipelineDepthVec);
+
+/* explore groupSize, workFactor, blocksNum and kitersNum for device,
+ * returns config with the best parameters */
+extern GPUStressConfig autotuneGPUStressConfig(cxuint id, cl::Device& clDevice,
+            const GPUStressConfig& config);
+
+extern std::string getGPUStressConfigsOptions(const std::vector<GPUStressConfig>& configs);
 
 extern void installOutputHandler(std::ostream* out, std::ostream* err,
                 OutputHandler handler = nullptr, void* data = nullptr);
@@ -142,36 +219,136 @@ private:
     typedef std::chrono::time_point<RealtimeClock> rt_time_point;
     typedef std::chrono::time_point<SteadyClock> std_time_point;
     
-    cxuint stepsPerWait;
+    cxuint stepsPerWait; // max queued kernels, adjusted by flow controller
+    double avgKernelNanos;
+    std_time_point lastPassEndTime; // completion of last kernel of previous pass
     
     rt_time_point startTime;
     std_time_point lastTime;
     
     cl::CommandQueue clCmdQueue1, clCmdQueue2;
     
-    cl::Buffer clBuffer1, clBuffer2;
-    cl::Buffer clBuffer3, clBuffer4;
+    /* host array in pinned memory, mapped from buffer for whole lifetime */
+    struct PinnedHostArray
+    {
+        cl::Buffer clBuffer;
+        float* mapped;
+    };
+    bool usePinnedHostArrays;
+    // declared before owners of host arrays, hence it is destroyed after them
+    std::vector<PinnedHostArray> pinnedHostArrays;
+    
+    /* owner of host array (pageable or pinned), frees array by freeHostArray */
+    struct HostArrayDeleter
+    {
+        GPUStressTester* tester;
+        HostArrayDeleter() : tester(nullptr)
+        { }
+        explicit HostArrayDeleter(GPUStressTester* _tester) : tester(_tester)
+        { }
+        void operator()(float* array) const
+        {
+            if (tester != nullptr)
+                tester->freeHostArray(array);
+        }
+    };
+    typedef std::unique_ptr<float[], HostArrayDeleter> HostArray;
+    
+    /* single buffer set in pipeline: input (and output) buffer and state of
+     * execution queued on this buffer set */
+    struct BufferSet
+    {
+        cl::Buffer clBuffer1, clBuffer2;
+        cl::Kernel clKernels[2]; // bound to buffers (second swapped in inputAndOutput)
+        cl::Event lastEvent; // only event of last kernel is kept to the check
+        cl::Buffer clMismatchBuffer; // mismatch count and indices (device verification)
+        cl::Event verifyEvent;
+        std::vector<uint64_t> mismatchInfo; // count and 64-bit indices
+        cl::Buffer clSignatureBuffer; // per-workgroup signatures of last kernel output
+        std::vector<cxuint> signatures;
+        cl::Event readEvent;
+        HostArray results;
+        GPUStressTester* tester; // for read callback
+        bool readCompleted; // set by read callback (guarded by readMutex)
+        bool kernelCompleted; // set by last kernel callback (guarded by readMutex)
+        std_time_point enqueueTime; // when queueing of pass started
+        std_time_point completedTime; // set by last kernel callback
+        cl_int kernelStatus; // first error reported by kernel callbacks
+        cxuint pendingKernels; // kernels not yet completed (guarded by readMutex)
+        cl_int readStatus;
+        cxuint passNum;
+        bool isExecuted; // if all kernels queued and results not yet checked
+    };
+    
+    std::vector<BufferSet> bufferSets;
+    
+    /* memory pool: buffers of buffer sets are rotated over regions of pool */
+    cl_ulong poolSize; // zero if pool is not used
+    std::vector<cl::Buffer> poolBuffers;
+    /* region of pool: sub-buffer with kernels bound to it and to next region
+     * (second swapped in inputAndOutput) */
+    struct PoolRegion
+    {
+        cl::Buffer buffer;
+        cl::Kernel clKernels[2];
+        cl::Buffer clSignatureBuffer; // signatures of buffer set in this region
+    };
+    std::vector<PoolRegion> poolRegions; // sub-buffers of pool buffers
+    size_t nextPoolRegion;
+    cxuint poolCycles; // how many times all regions have been used
+    std::mutex readMutex;
+    std::condition_variable readCond;
+    cxuint pendingCallbacks;
+    int64_t eventNanos; // host time spent in waiting for events
+    int64_t eventOverheadNanos; // host time spent in managing events
+    cl::Buffer clInitBuffer; // initial values resident in device memory
+    cl::Buffer clCompareBuffer; // results to compare resident in device memory
+    std::vector<cxuint> goldenSignatures; // signatures of results to compare
+    
+    /* chunk of results and results to compare (streaming verification) */
+    struct StreamChunk
+    {
+        std::unique_ptr<float[]> expected;
+        std::unique_ptr<float[]> results;
+        cl::Event expectedEvent, resultsEvent;
+    };
+    std::vector<StreamChunk> streamChunks; // ring of chunks
     
     cxuint workFactor;
     cxuint blocksNum;
     cxuint passItersNum;
     cxuint kitersNum;
     bool useInputAndOutput;
+    cxuint pipelineDepth;
     
     size_t bufItemsNum;
     
-    float* initialValues;
-    float* toCompare;
-    float* results;
+    HostArray initialValues;
+    HostArray toCompare;
+    
+    double transferredBytes;
+    cl_ulong transferNanos;
     
     size_t clKernelSourceSize;
     const char* clKernelSource;
     
     bool usePolyWalker;
+    cxuint initValuesType;
+    cxuint flopsPerIter; // per element and kernel iteration, zero for memory tests
+    bool useFP64; // double precision test
+    int verificationMode; // from option or forced by test type (hides global)
     
     cl::Program clProgram;
     cl::Kernel clKernel;
     
+    // program built before calibration (while initial values are generated)
+    cl::Program preparedProgram;
+    cxuint preparedKitersNum;
+    size_t preparedGroupSize;
+    
+    cl::Program clVerifyProgram;
+    cl::Kernel clVerifyKernel;
+    
     size_t groupSize;
     size_t workSize;
     
@@ -180,14 +357,93 @@ private:
     
     bool initialized;
     
-    void printBuildLog();
+    void printBuildLog(const cl::Program& program);
+    void applyMemoryTarget(cl_uint maxComputeUnits);
+    void createMemoryPool();
+    const PoolRegion& takePoolRegion();
+    void rotatePoolRegions(BufferSet& bufSet);
+    HostArray allocHostArray();
+    void freeHostArray(float* array);
+    void addTransferTime(const cl::Event& clEvent, size_t bytes);
     void printStatus(cxuint passNum);
     void throwFailedComputations(cxuint passNum);
+    /* mismatches (can be accumulated from chunks of results) */
+    struct MismatchStats
+    {
+        size_t mismatchesNum;
+        size_t index[2]; // first and last
+        cl_uint expected[2];
+        cl_uint result[2];
+        cl_uint xorBits;
+    };
+    static void addMismatches(MismatchStats& stats, const float* expected,
+            const float* results, size_t n, size_t offset);
+    void printMismatchReport(const float* expected, const float* results);
+    void printMismatchReport(const MismatchStats& stats);
+    
+    const cl::Buffer& getResultsBuffer(const BufferSet& bufSet) const
+    { return (!useInputAndOutput || (passItersNum&1) == 0) ?
+            bufSet.clBuffer1 : bufSet.clBuffer2; }
     
-    void buildKernel(cxuint kitersNum, cxuint blocksNum, bool alwaysPrintBuildLog,
-         bool whenCalibrates);
+    cxuint getSignaturesArgIndex() const
+    { return usePolyWalker ? 8 : 3; }
+    const char* getPerfUnit() const
+    { return getPerfUnit(useFP64); }
+    cxuint getKitersArgIndex() const
+    { return getSignaturesArgIndex() + (verificationMode == 2 ? 1 : 0); }
+    size_t getGroupsNum() const
+    { return workSize/groupSize; }
+    
+    cl::Kernel createBoundKernel(const cl::Buffer& signatureBuffer);
+    void bindKernelBuffers(cl::Kernel* kernels, const cl::Buffer& buffer1,
+                const cl::Buffer& buffer2);
+    void bindKernels();
+    void runEnqueueBenchmark();
+    bool checkStopping();
+    bool enqueueExecution(BufferSet& bufSet);
+    void enqueueReadResults(BufferSet& bufSet);
+    static void CL_CALLBACK notifyReadCompleted(cl_event clEvent, cl_int status,
+                void* data);
+    static void CL_CALLBACK notifyKernelCompleted(cl_event clEvent, cl_int status,
+                void* data);
+    static void CL_CALLBACK notifyKernelStatus(cl_event clEvent, cl_int status,
+                void* data);
+    void watchKernelEvent(BufferSet& bufSet, cl::Event& clEvent);
+    void updateStepsPerWait(const BufferSet& bufSet);
+    void waitForResults(BufferSet& bufSet);
+    void waitForPendingReads();
+    void checkExecutionEvents(BufferSet& bufSet);
+    void checkResults(BufferSet& bufSet);
+    void checkResultsOnDevice(BufferSet& bufSet);
+    void checkSignatures(BufferSet& bufSet);
+    void checkResultsStreaming(BufferSet& bufSet);
+    void readAndReportMismatches(BufferSet& bufSet);
+    
+    cl::Program buildProgram(cxuint kitersNum, cxuint blocksNum, size_t groupSize);
+    size_t useProgram(const cl::Program& program);
+    void prebuildProgram();
+    void buildKernel(cxuint kitersNum, cxuint blocksNum, bool alwaysPrintBuildLog);
+    uint64_t getSourceHash() const;
+    std::string getCalibrationKey() const;
+    cl_ulong profileKernel(cl::CommandQueue& profCmdQueue, const TimingConfig& timing,
+            cxuint* samplesNum = nullptr);
+    
+    struct KitersScore
+    {
+        cxuint kitersNum;
+        double bandwidth;
+        double perf;
+        cl_ulong kernelTime;
+    };
+    bool profileKitersVariants(const std::vector<cxuint>& kitersList,
+            const TimingConfig& timing, cxuint plannedNum, cl::CommandQueue& profCmdQueue,
+            cxuint& profiledNum, cxuint& kernelRunsNum, KitersScore& best,
+            std::map<cxuint, double>& scores);
     void calibrateKernel();
 public:
+    static const char* getPerfUnit(bool useFP64)
+    { return useFP64 ? "GFLOPS (fp64)" : "GFLOPS"; }
+    
     GPUStressTester(cxuint id, cl::Device& clDevice, const GPUStressConfig& config);
     ~GPUStressTester();
     
@@ -202,4 +458,19 @@ public:
     { return failMessage; }
 };
 
+/* returns true if device can run test from config (double precision tests) */
+extern bool isGPUStressConfigSupported(const cl::Device& clDevice,
+            const GPUStressConfig& config);
+
+/* prints message about device which is skipped, because can't run test */
+extern void printUnsupportedDevice(cxuint id, const cl::Device& clDevice);
+
+/* construct testers for all devices concurrently. errors are reported for every
+ * device. testers which are not created (failed, skipped because device can't
+ * run test, or stopped by user) are null. returns false if any tester failed
+ * or if no device can run test */
+extern bool createGPUStressTesters(std::vector<cl::Device>& clDevices,
+            const std::vector<GPUStressConfig>& configs,
+            std::vector<GPUStressTester*>& testers);
+
 #endif
@@ -92,6 +92,7 @@ static const char* workFactorsString = nullptr;
 static const char* blocksNumsString = nullptr;
 static const char* passItersNumsString = nullptr;
 static const char* kitersNumsString = nullptr;
+static const char* pipelineDepthsString = nullptr;
 static int printHelp = 0;
 static int printUsage = 0;
 static int printVersion = 0;
@@ -113,7 +114,7 @@ static const poptOption optionsTable[] =
         "Use NVIDIA platform", nullptr },
     { "useIntel", 'E', POPT_ARG_VAL, &useIntelPlatform, 'L', "Use Intel platform", nullptr },
     { "testType", 'T', POPT_ARG_STRING, &builtinKernelsString, 'T',
-        "Choose test type (kernel) (range 0-3)", "NUMLIST" },
+        "Choose test type (kernel) (range 0-9)", "NUMLIST" },
     { "inAndOut", 'I', POPT_ARG_STRING|POPT_ARGFLAG_OPTIONAL, &inputAndOutputsString, 'I',
         "Use input and output buffers (doubles memory reqs.)", "BOOLLIST" },
     { "workFactor", 'W', POPT_ARG_STRING, &workFactorsString, 'W',
@@ -126,8 +127,41 @@ static const poptOption optionsTable[] =
         "Set pass iterations num", "ITERSLIST" },
     { "kitersNum", 'j', POPT_ARG_STRING, &kitersNumsString, 'j',
         "Set kernel iterations number (range 1-100)", "ITERSLIST" },
+    { "pipelineDepth", 'P', POPT_ARG_STRING, &pipelineDepthsString, 'P',
+        "Set number of buffer sets in pipeline (range 1-16)", "DEPTHLIST" },
     { "exitIfAllFails", 'f', POPT_ARG_VAL, &exitIfAllFails, 'f',
         "Exit only when all devices will fail at computation", nullptr },
+    { "verifyMode", 'v', POPT_ARG_INT, &verificationMode, 'v',
+        "Set results verification mode (0 - on host, 1 - on device, 2 - signatures, "
+        "3 - streaming)",
+        "MODE" },
+    { "pinnedMemory", 'M', POPT_ARG_VAL, &usePinnedMemory, 'M',
+        "Use pinned host memory for transfers", nullptr },
+    { "stopLatency", 'y', POPT_ARG_INT, &maxStopLatency, 'y',
+        "Set maximal latency of stopping test in milliseconds (default 300)", "MILLIS" },
+    { "enqueueBench", 'Q', POPT_ARG_VAL, &enqueueBenchmark, 'Q',
+        "Measure throughput of kernels queueing before test", nullptr },
+    { "programCache", 'K', POPT_ARG_STRING, &programCacheDir, 'K',
+        "Cache binaries of compiled programs in directory", "DIRECTORY" },
+    { "calibrationDB", 'D', POPT_ARG_STRING, &calibrationDBFile, 'D',
+        "Store calibrations in file and reuse them", "FILE" },
+    { "calibrationTolerance", 'x', POPT_ARG_INT, &calibrationTolerance, 'x',
+        "Set tolerance of stored calibration validation in percents (default 10)",
+        "PERCENT" },
+    { "exhaustiveCalibration", 'X', POPT_ARG_VAL, &exhaustiveCalibration, 'X',
+        "Calibrate by checking all kitersNum values (1-40)", nullptr },
+    { "specializedCalibration", 'Z', POPT_ARG_VAL, &specializedCalibration, 'Z',
+        "Calibrate by compiling program for every checked kitersNum", nullptr },
+    { "seed", 'R', POPT_ARG_STRING, &randomSeedString, 'R',
+        "Set seed of random initial values (default random)", "SEED" },
+    { "hostInitialValues", 'H', POPT_ARG_VAL, &hostInitialValues, 'H',
+        "Generate initial values on host and upload them", nullptr },
+    { "memTarget", 'm', POPT_ARG_STRING, &memoryTargetString, 'm',
+        "Set device memory used by test in megabytes or in percents of device memory "
+        "(with '%'), workFactor and blocksNum are derived from it", "MB|PERCENT%" },
+    { "memPool", 'O', POPT_ARG_STRING, &memoryPoolString, 'O',
+        "Allocate memory pool (in megabytes or in percents of device memory) and "
+        "use its other part in every pass", "MB|PERCENT%" },
     { "version", 'V', POPT_ARG_VAL, &printVersion, 'V', "Print program version", nullptr },
     { "help", '?', POPT_ARG_VAL, &printHelp, '?', "Show this help message", nullptr },
     { "usage", 0, POPT_ARG_VAL, &printUsage, 'u', "Display brief usage message", nullptr },
@@ -675,6 +709,7 @@ private:
     Fl_Spinner* kitersNumSpinner;
     Fl_Choice* builtinKernelChoice;
     Fl_Check_Button* inputAndOutputButton;
+    Fl_Spinner* pipelineDepthSpinner;
 public:
     SingleTestConfigGroup(const cl::Device& clDevice);
     GPUStressConfig getConfig() const;
@@ -720,6 +755,10 @@ SingleTestConfigGroup::SingleTestConfigGroup(const cl::Device& clDevice)
         builtinKernelChoice->add(s.c_str());
     inputAndOutputButton = new Fl_Check_Button(140, 277, 200, 25, "&Input and output");
     inputAndOutputButton->tooltip("Enable an using separate input buffer and output buffer");
+    pipelineDepthSpinner = new Fl_Spinner(560, 127, 150, 20, "Pipeline depth");
+    pipelineDepthSpinner->tooltip("Set number of buffer sets queued at same time");
+    pipelineDepthSpinner->range(1., 16);
+    pipelineDepthSpinner->step(1.0);
     group->end();
     
     Fl_Box* box = new Fl_Box(20, 300, 740, 60);
@@ -737,6 +776,7 @@ GPUStressConfig SingleTestConfigGroup::getConfig() const
     config.kitersNum = kitersNumSpinner->value();
     config.builtinKernel = builtinKernelChoice->value();
     config.inputAndOutput = inputAndOutputButton->value();
+    config.pipelineDepth = pipelineDepthSpinner->value();
     return config;
 }
 
@@ -748,18 +788,38 @@ void SingleTestConfigGroup::recomputeMemoryRequirements()
     size_t groupSize = groupSizeSpinner->value();
     const size_t blocksNum = blocksNumSpinner->value();
     const bool inputAndOutput = inputAndOutputButton->value();
+    const size_t pipelineDepth = pipelineDepthSpinner->value();
     
     if (groupSize == 0)
         clDevice.getInfo(CL_DEVICE_MAX_WORK_GROUP_SIZE, &groupSize);
     
     const size_t bufItemsNum = ((size_t(workFactor)*
                 groupSize*maxComputeUnits)<<4)*blocksNum;
-    double devMemReqs = 0.0;
-    if (inputAndOutput)
-        devMemReqs = (bufItemsNum<<4)/(1048576.0);
-    else
-        devMemReqs = (bufItemsNum<<3)/(1048576.0);
-    snprintf(memoryReqsBuffer, 128, "Required memory: %g MB", devMemReqs);
+    // initial values and (for device verification) results to compare
+    const cxuint otherBuffers =
+            (getTestVerificationMode(builtinKernelChoice->value()) != 0) ? 2 : 1;
+    const cxuint buffersPerSet = inputAndOutput ? 2 : 1;
+    cl_ulong globalMemSize;
+    clDevice.getInfo(CL_DEVICE_GLOBAL_MEM_SIZE, &globalMemSize);
+    try
+    {
+        double bufSize = double(bufItemsNum<<2);
+        double devMemReqs = bufSize*(double(pipelineDepth)*buffersPerSet + otherBuffers);
+        if (memoryTargetString != nullptr)
+        {   // workFactor and blocksNum will be derived from memory target
+            devMemReqs = double(parseMemoryTarget(memoryTargetString, globalMemSize));
+            bufSize = devMemReqs / (double(pipelineDepth)*buffersPerSet + otherBuffers);
+        }
+        if (memoryPoolString != nullptr) // buffer sets are regions of memory pool
+            devMemReqs = double(parseMemoryTarget(memoryPoolString, globalMemSize)) +
+                    bufSize*otherBuffers;
+        snprintf(memoryReqsBuffer, 128, "Required memory: %g MB%s%s",
+                 devMemReqs/1048576.0,
+                 (memoryTargetString != nullptr) ? " (memory target)" : "",
+                 (memoryPoolString != nullptr) ? " (with memory pool)" : "");
+    }
+    catch(const std::exception& ex)
+    { snprintf(memoryReqsBuffer, 128, "Required memory: %s", ex.what()); }
     memoryReqsBox->label(memoryReqsBuffer);
 }
 
@@ -796,6 +856,7 @@ void SingleTestConfigGroup::setConfig(const cl::Device& _clDevice,
     kitersNumSpinner->value(config.kitersNum);
     builtinKernelChoice->value(config.builtinKernel);
     inputAndOutputButton->value(config.inputAndOutput);
+    pipelineDepthSpinner->value(config.pipelineDepth);
     
     recomputeMemoryRequirements();
 }
@@ -809,6 +870,7 @@ void SingleTestConfigGroup::installCallback(void (*cb)(Fl_Widget*, void*), void*
     kitersNumSpinner->callback(cb, data);
     builtinKernelChoice->callback(cb, data);
     inputAndOutputButton->callback(cb, data);
+    pipelineDepthSpinner->callback(cb, data);
 }
 
 /*
@@ -995,6 +1057,7 @@ void TestConfigsGroup::applyBestTestConfig(cl_device_id inClDeviceId)
         config.kitersNum = 0;
         config.builtinKernel = 0;
         config.inputAndOutput = false;
+        config.pipelineDepth = 2;
         allConfigsMap.insert(std::make_pair(inClDeviceId, config));
     }
 }
@@ -1846,28 +1909,24 @@ void GUIApp::runStress()
     
     try
     {
-        cxuint j = 0;
-        bool ifExitingAtInit = false;
+        std::vector<cl::Device> clDevices;
+        std::vector<GPUStressConfig> configs;
         for (cxuint i = 0; i < num; i++)
             if (deviceChoiceGrp->isClDeviceEnabled(i))
             {
-                const GPUStressConfig& config = testConfigsGrp->getStressConfig(j);
-                cl::Device clDevice = deviceChoiceGrp->getClDevice(i);
-                GPUStressTester* stressTester = new GPUStressTester(j, clDevice, config);
-                
-                if (!stressTester->isInitialized())
-                {
-                    ifExitingAtInit = true;
-                    delete stressTester;
-                    break;
-                }
-                gpuStressTesters.push_back(stressTester);
-                j++;
+                configs.push_back(testConfigsGrp->getStressConfig(clDevices.size()));
+                clDevices.push_back(deviceChoiceGrp->getClDevice(i));
             }
+        // all devices are prepared concurrently
+        if (!createGPUStressTesters(clDevices, configs, gpuStressTesters))
+            testFinishedWithException = true;
+        // null testers of skipped devices are not started
+        const bool ifExitingAtInit = stopAllStressTestersByUser.load();
         
         if (!ifExitingAtInit)
             for (GPUStressTester* tester: gpuStressTesters)
-                testerThreads.push_back(new std::thread(&GPUStressTester::runTest, tester));
+                testerThreads.push_back((tester != nullptr) ?
+                        new std::thread(&GPUStressTester::runTest, tester) : nullptr);
     }
     catch(const cl::Error& err)
     {
@@ -1919,6 +1978,8 @@ void GUIApp::runStress()
         
         for (size_t i = 0; i < gpuStressTesters.size(); i++)
         {
+            if (gpuStressTesters[i] == nullptr)
+                continue;
             if (gpuStressTesters[i]->isFailed())
             {
                 std::lock_guard<std::mutex> l(stdOutputMutex);
@@ -2133,10 +2194,12 @@ int main(int argc, const char** argv)
                     parseCmdUIntList(builtinKernelsString, "testTypes");
             std::vector<bool> inputAndOutputs =
                     parseCmdBoolList(inputAndOutputsString, "inputAndOutputs");
+            std::vector<cxuint> pipelineDepths =
+                    parseCmdUIntList(pipelineDepthsString, "pipeline depths");
             
             gpuStressConfigs = collectGPUStressConfigs(choosenClDevices.size(),
                     passItersNums, groupSizes, workFactors, blocksNums, kitersNums,
-                    builtinKernels, inputAndOutputs);
+                    builtinKernels, inputAndOutputs, pipelineDepths);
         }
                 
         /* run window */